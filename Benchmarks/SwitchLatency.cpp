@@ -0,0 +1,290 @@
+/*
+ ==============================================================================
+
+ ABComparison Plug-in
+ Copyright (C) 2018 - Daniel Rudrich
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ ==============================================================================
+ */
+
+/*
+ ===== ABComparisonSwitchLatency =====
+ Measures the end-to-end latency of a switch: from sending `/switch i` over a local UDP socket
+ to the first output sample of the new choice.
+
+ A simulated audio thread calls processBlock in real time, as a sound card would. Every choice
+ plays a different DC level, so the sample where the output changes is known exactly. The
+ latency is the time from sending the message to the time that sample would be played, i.e.
+ the start of its block plus its position within the block.
+
+ Both conditions are measured: an idle message thread, and one which is kept busy with
+ 5ms chunks of work, like a heavy GUI would.
+
+ Usage:
+    ABComparisonSwitchLatency [--trials <n>] [--block <size>] [--rate <Hz>] [--port <port>]
+ */
+
+#include <iostream>
+#include <thread>
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../Source/PluginProcessor.h"
+
+//==============================================================================
+static double ticksToMilliseconds (juce::int64 ticks)
+{
+    return juce::Time::highResolutionTicksToSeconds (ticks) * 1000.0;
+}
+
+static float getLevel (int choice)
+{
+    return 0.25f * (choice + 1);
+}
+
+/** Calls processBlock at the pace of a real audio device and detects the switches. */
+class SimulatedAudioThread : public juce::Thread
+{
+public:
+    SimulatedAudioThread (AbcomparisonAudioProcessor& p, double rate, int size)
+        : juce::Thread ("simulated audio"), processor (p), sampleRate (rate), blockSize (size),
+          buffer (juce::jmax (p.getTotalNumInputChannels(), p.getTotalNumOutputChannels()), size)
+    {
+    }
+
+    /** Arms the detection of the next switch, to be called right before sending it. */
+    void expectSwitch (int choice)
+    {
+        expectedChoice = choice;
+        sendTicks = juce::Time::getHighResolutionTicks();
+        detected = false;
+    }
+
+    bool hasDetectedSwitch() const { return detected.load(); }
+    juce::int64 getLatencyTicks() const { return latencyTicks.load(); }
+
+    void run() override
+    {
+        const auto ticksPerBlock = static_cast<juce::int64> (juce::Time::getHighResolutionTicksPerSecond() * blockSize / sampleRate);
+        auto blockStart = juce::Time::getHighResolutionTicks();
+
+        while (! threadShouldExit())
+        {
+            // wait for the device to ask for the next block
+            blockStart += ticksPerBlock;
+            while (juce::Time::getHighResolutionTicks() < blockStart)
+                if (ticksToMilliseconds (blockStart - juce::Time::getHighResolutionTicks()) > 1.5)
+                    juce::Thread::sleep (1);
+
+            for (int choice = 0; choice < 2; ++choice)
+                juce::FloatVectorOperations::fill (buffer.getWritePointer (choice), getLevel (choice), blockSize);
+
+            processor.processBlock (buffer, midi);
+
+            if (detected.load())
+                continue;
+
+            // the first sample of the expected choice
+            const auto* output = buffer.getReadPointer (0);
+            const float level = getLevel (expectedChoice.load());
+            for (int i = 0; i < blockSize; ++i)
+            {
+                if (std::abs (output[i] - level) < 1.0e-6f)
+                {
+                    const auto audibleAt = blockStart + static_cast<juce::int64> (juce::Time::getHighResolutionTicksPerSecond() * i / sampleRate);
+                    latencyTicks = audibleAt - sendTicks.load();
+                    detected = true;
+                    break;
+                }
+            }
+        }
+    }
+
+private:
+    AbcomparisonAudioProcessor& processor;
+    const double sampleRate;
+    const int blockSize;
+    juce::AudioBuffer<float> buffer;
+    juce::MidiBuffer midi;
+
+    std::atomic<int> expectedChoice { 0 };
+    std::atomic<juce::int64> sendTicks { 0 };
+    std::atomic<juce::int64> latencyTicks { 0 };
+    std::atomic<bool> detected { true };
+};
+
+/** Keeps the message thread busy with chunks of work, like a heavy GUI would. */
+class MessageThreadStress : public juce::Thread
+{
+public:
+    MessageThreadStress() : juce::Thread ("message thread stress") {}
+
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            if (pending.load() < 2)
+            {
+                ++pending;
+                juce::MessageManager::callAsync ([this]
+                {
+                    const auto end = juce::Time::getMillisecondCounterHiRes() + 5.0;
+                    while (juce::Time::getMillisecondCounterHiRes() < end) {}
+                    --pending;
+                });
+            }
+
+            juce::Thread::sleep (1);
+        }
+    }
+
+private:
+    std::atomic<int> pending { 0 };
+};
+
+//==============================================================================
+struct Statistics
+{
+    double p50, p99, max;
+};
+
+static Statistics getStatistics (std::vector<double> latencies)
+{
+    std::sort (latencies.begin(), latencies.end());
+    auto percentile = [&latencies] (double p) { return latencies[static_cast<size_t> (p * (latencies.size() - 1) + 0.5)]; };
+    return { percentile (0.5), percentile (0.99), latencies.back() };
+}
+
+/** Sends `/switch` alternating between the first two choices, and waits for each switch to be audible. */
+static bool measure (juce::OSCSender& sender, SimulatedAudioThread& audioThread, int numTrials, std::vector<double>& latencies)
+{
+    juce::Random random;
+    int choice = 0;
+
+    for (int trial = 0; trial < numTrials; ++trial)
+    {
+        // random pauses, so the messages arrive at random positions relative to the blocks
+        juce::Thread::sleep (20 + random.nextInt (30));
+
+        choice = 1 - choice;
+        audioThread.expectSwitch (choice);
+        if (! sender.send (juce::OSCAddressPattern ("/switch"), choice + 1))
+            return false;
+
+        const auto timeout = juce::Time::getMillisecondCounter() + 2000;
+        while (! audioThread.hasDetectedSwitch())
+        {
+            if (juce::Time::getMillisecondCounter() > timeout)
+                return false;
+
+            juce::Thread::sleep (1);
+        }
+
+        latencies.push_back (ticksToMilliseconds (audioThread.getLatencyTicks()));
+    }
+
+    return true;
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    int numTrials = 200;
+    int blockSize = 256;
+    double sampleRate = 48000.0;
+    int port = 9333;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const juce::String arg (argv[i]), value (argv[i + 1]);
+
+        if (arg == "--trials")
+            numTrials = juce::jmax (1, value.getIntValue());
+        else if (arg == "--block")
+            blockSize = juce::jlimit (16, 8192, value.getIntValue());
+        else if (arg == "--rate")
+            sampleRate = juce::jlimit (8000.0, 384000.0, value.getDoubleValue());
+        else if (arg == "--port")
+            port = value.getIntValue();
+        else
+        {
+            std::cerr << "Usage: ABComparisonSwitchLatency [--trials <n>] [--block <size>] [--rate <Hz>] [--port <port>]" << std::endl;
+            return 1;
+        }
+    }
+
+    // two mono choices with instant switching, exclusive solo
+    AbcomparisonAudioProcessor processor;
+    for (auto* parameter : processor.getParameters())
+        if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*> (parameter))
+            if (ranged->paramID == "numberOfChoices" || ranged->paramID == "channelSize" || ranged->paramID == "fadeTime")
+                ranged->setValueNotifyingHost (0.0f);
+
+    processor.getOSCReceiver().setPort (port);
+    processor.setOSCEnabled (true);
+
+    processor.setRateAndBufferSizeDetails (sampleRate, blockSize);
+    processor.prepareToPlay (sampleRate, blockSize);
+
+    juce::OSCSender sender;
+    if (! sender.connect ("127.0.0.1", port))
+    {
+        std::cerr << "Couldn't open a UDP socket." << std::endl;
+        return 1;
+    }
+
+    SimulatedAudioThread audioThread (processor, sampleRate, blockSize);
+    MessageThreadStress stress;
+    int result = 0;
+
+    // the measurement runs on its own thread, the OSC messages are delivered on the message thread
+    std::thread benchmark ([&]
+    {
+        audioThread.startThread (juce::Thread::Priority::highest);
+
+        std::cout << "Switch latency, " << numTrials << " trials, block size " << blockSize << " at " << sampleRate << " Hz" << std::endl;
+
+        for (const bool stressed : { false, true })
+        {
+            if (stressed)
+                stress.startThread();
+
+            std::vector<double> latencies;
+            if (! measure (sender, audioThread, numTrials, latencies))
+            {
+                std::cerr << "A switch didn't arrive, is port " << port << " in use?" << std::endl;
+                result = 1;
+                break;
+            }
+
+            const auto statistics = getStatistics (latencies);
+            std::cout << (stressed ? "stressed" : "idle    ") << " message thread:"
+                      << "  p50 " << juce::String (statistics.p50, 2) << " ms"
+                      << "  p99 " << juce::String (statistics.p99, 2) << " ms"
+                      << "  max " << juce::String (statistics.max, 2) << " ms" << std::endl;
+        }
+
+        stress.stopThread (1000);
+        audioThread.stopThread (1000);
+        juce::MessageManager::getInstance()->stopDispatchLoop();
+    });
+
+    juce::MessageManager::getInstance()->runDispatchLoop();
+    benchmark.join();
+
+    processor.releaseResources();
+    return result;
+}
@@ -0,0 +1,161 @@
+/*
+ ==============================================================================
+
+ ABComparison Plug-in
+ Copyright (C) 2018 - Daniel Rudrich
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ ==============================================================================
+ */
+
+/*
+ ===== ABComparisonThroughput =====
+ Measures how fast processBlock mixes wide buses at large block sizes, with the mixer working
+ in cache-sized tiles and, for comparison, on whole blocks. The time covers all of processBlock,
+ so everything the engine reads the sources for is measured together: the silence detection,
+ the copies of sources the mix would overwrite, and the mix itself.
+
+ All choices are on (toggle mode), so every source is read and mixed into the output. The input
+ is noise, restored from an untouched copy before each block, outside of the measured time.
+ The memory bandwidth counts each source sample read once and each output sample written once.
+ With --delay, the first choice is delayed, so it's read from a copy of its channels instead of in place.
+
+ Usage:
+    ABComparisonThroughput [--choices <n>] [--channels <n>] [--seconds <s>] [--rate <Hz>] [--delay <samples>]
+ */
+
+#include <iostream>
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../Source/PluginProcessor.h"
+
+//==============================================================================
+static void setParameter (AbcomparisonAudioProcessor& processor, const juce::String& paramID, float value)
+{
+    for (auto* parameter : processor.getParameters())
+        if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*> (parameter))
+            if (ranged->paramID == paramID)
+                ranged->setValueNotifyingHost (ranged->convertTo0to1 (value));
+}
+
+/** Nanoseconds spent in processBlock, per sample. */
+static double measure (AbcomparisonAudioProcessor& processor, const juce::AudioBuffer<float>& input, int blockSize, int numSamples)
+{
+    juce::AudioBuffer<float> buffer (input.getNumChannels(), blockSize);
+    juce::MidiBuffer midi;
+    juce::int64 ticks = 0;
+
+    const int numBlocks = juce::jmax (1, numSamples / blockSize);
+    for (int block = -8; block < numBlocks; ++block) // a few blocks to warm up the caches
+    {
+        for (int channel = 0; channel < input.getNumChannels(); ++channel)
+            buffer.copyFrom (channel, 0, input, channel, 0, blockSize);
+
+        const auto start = juce::Time::getHighResolutionTicks();
+        processor.processBlock (buffer, midi);
+        if (block >= 0)
+            ticks += juce::Time::getHighResolutionTicks() - start;
+    }
+
+    return juce::Time::highResolutionTicksToSeconds (ticks) * 1.0e9 / (static_cast<double> (numBlocks) * blockSize);
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    int nChoices = 8;
+    int nChannels = 8;
+    double seconds = 10.0;
+    double sampleRate = 48000.0;
+    int delay = 0;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const juce::String arg (argv[i]), value (argv[i + 1]);
+
+        if (arg == "--choices")
+            nChoices = juce::jlimit (2, AbcomparisonAudioProcessor::maxNChoices, value.getIntValue());
+        else if (arg == "--channels")
+            nChannels = juce::jlimit (1, AbcomparisonAudioProcessor::maxChannelSize, value.getIntValue());
+        else if (arg == "--seconds")
+            seconds = juce::jlimit (0.1, 600.0, value.getDoubleValue());
+        else if (arg == "--rate")
+            sampleRate = juce::jlimit (8000.0, 384000.0, value.getDoubleValue());
+        else if (arg == "--delay")
+            delay = juce::jlimit (0, AbcomparisonAudioProcessor::Engine::Alignment::maxDelay, value.getIntValue());
+        else
+        {
+            std::cerr << "Usage: ABComparisonThroughput [--choices <n>] [--channels <n>] [--seconds <s>] [--rate <Hz>] [--delay <samples>]" << std::endl;
+            return 1;
+        }
+    }
+
+    AbcomparisonAudioProcessor processor;
+    if (nChoices * nChannels > processor.getTotalNumInputChannels())
+    {
+        std::cerr << nChoices << " choices of " << nChannels << " channels don't fit into the "
+                  << processor.getTotalNumInputChannels() << " channels of the main bus." << std::endl;
+        return 1;
+    }
+
+    setParameter (processor, "numberOfChoices", nChoices - 2.0f);
+    setParameter (processor, "channelSize", nChannels - 1.0f);
+    setParameter (processor, "switchMode", 1.0f);
+    for (int choice = 0; choice < nChoices; ++choice)
+        setParameter (processor, "choiceState" + juce::String (choice), 1.0f);
+
+    processor.setChoiceDelays (juce::String (delay));
+
+    const int blockSizes[] = { 512, 2048, 4096, 8192 };
+    const int maxBlockSize = blockSizes[juce::numElementsInArray (blockSizes) - 1];
+    processor.setRateAndBufferSizeDetails (sampleRate, maxBlockSize);
+    processor.prepareToPlay (sampleRate, maxBlockSize);
+
+    juce::AudioBuffer<float> input (juce::jmax (processor.getTotalNumInputChannels(), processor.getTotalNumOutputChannels()), maxBlockSize);
+    juce::Random random;
+    for (int channel = 0; channel < input.getNumChannels(); ++channel)
+        for (int i = 0; i < maxBlockSize; ++i)
+            input.setSample (channel, i, 0.5f * random.nextFloat() - 0.25f);
+
+    // let the fades of the switched-on choices finish
+    measure (processor, input, maxBlockSize, juce::roundToInt (sampleRate));
+
+    const int numSamples = juce::roundToInt (seconds * sampleRate);
+    const double bytesPerSample = sizeof (float) * (nChoices * nChannels + nChannels);
+
+    std::cout << "Throughput, " << nChoices << " choices of " << nChannels << " channels at " << sampleRate << " Hz";
+    if (delay > 0)
+        std::cout << ", first choice delayed by " << delay << " samples";
+
+    std::cout << std::endl;
+
+    for (const int blockSize : blockSizes)
+    {
+        for (const bool tiled : { false, true })
+        {
+            processor.setMixTileLength (tiled ? 0 : std::numeric_limits<int>::max());
+            const double nanoseconds = measure (processor, input, blockSize, numSamples);
+
+            std::cout << "block " << juce::String (blockSize).paddedLeft (' ', 5) << (tiled ? "  tiled  " : "  untiled")
+                      << "  " << juce::String (nanoseconds, 2) << " ns/sample"
+                      << "  " << juce::String (1.0e9 / (nanoseconds * sampleRate), 1) << "x realtime"
+                      << "  " << juce::String (bytesPerSample / nanoseconds, 2) << " GB/s" << std::endl;
+        }
+    }
+
+    processor.releaseResources();
+    return 0;
+}
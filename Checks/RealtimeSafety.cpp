@@ -0,0 +1,302 @@
+/*
+ ==============================================================================
+
+ ABComparison Plug-in
+ Copyright (C) 2018 - Daniel Rudrich
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ ==============================================================================
+ */
+
+/*
+ ===== ABComparisonRealtimeCheck =====
+ Runs the processor through its features with the real-time checks compiled in (see
+ RealtimeChecker.h), and fails with exit code 1 if processBlock or parameterChanged allocated,
+ freed or locked a mutex on the way. The call stacks of the first violations are printed.
+
+ Each scenario is set up from the message thread's side, then the host plays blocks of random
+ sizes, automates parameters between the blocks, sends MIDI, and calls the processor's timer
+ now and then, as the message thread would.
+
+ Usage:
+    ABComparisonRealtimeCheck [--block <size>] [--rate <Hz>] [--blocks <n>] [--reports <n>]
+ */
+
+#include <functional>
+#include <iostream>
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../Source/PluginProcessor.h"
+
+#if ! ABCOMPARISON_REALTIME_CHECKS
+ #error "ABComparisonRealtimeCheck needs ABCOMPARISON_REALTIME_CHECKS=1"
+#endif
+
+//==============================================================================
+/** A running transport at 120 bpm in 4/4, for quantization and auto-cycle. */
+class TransportPlayHead : public juce::AudioPlayHead
+{
+public:
+    juce::Optional<PositionInfo> getPosition() const override
+    {
+        const double ppq = timeInSamples / sampleRate * 2.0;
+
+        PositionInfo info;
+        info.setIsPlaying (true);
+        info.setTimeInSamples (timeInSamples);
+        info.setBpm (120.0);
+        info.setTimeSignature (TimeSignature { 4, 4 });
+        info.setPpqPosition (ppq);
+        info.setPpqPositionOfLastBarStart (std::floor (ppq / 4.0) * 4.0);
+        return info;
+    }
+
+    double sampleRate = 48000.0;
+    juce::int64 timeInSamples = 0;
+};
+
+/** Sets a parameter by its ID, like host automation. */
+static void automate (AbcomparisonAudioProcessor& processor, const juce::String& paramID, float value)
+{
+    for (auto* parameter : processor.getParameters())
+        if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*> (parameter))
+            if (ranged->paramID == paramID)
+                ranged->setValueNotifyingHost (ranged->convertTo0to1 (value));
+}
+
+struct Scenario
+{
+    const char* name;
+    std::function<void (AbcomparisonAudioProcessor&)> setUp;                      // message thread, before the blocks
+    std::function<void (AbcomparisonAudioProcessor&, int, juce::MidiBuffer&)> perBlock; // host, before each block
+};
+
+/** A few seconds of noise in a temporary WAV file, for the file players. */
+static juce::File writeTestFile (double sampleRate)
+{
+    auto file = juce::File::createTempFile (".wav");
+    juce::AudioBuffer<float> noise (2, juce::roundToInt (sampleRate * 4.0));
+    juce::Random random;
+    for (int ch = 0; ch < noise.getNumChannels(); ++ch)
+        for (int i = 0; i < noise.getNumSamples(); ++i)
+            noise.setSample (ch, i, 0.2f * random.nextFloat() - 0.1f);
+
+    juce::WavAudioFormat format;
+    std::unique_ptr<juce::AudioFormatWriter> writer (format.createWriterFor (new juce::FileOutputStream (file), sampleRate, 2, 24, {}, 0));
+    if (writer != nullptr)
+        writer->writeFromAudioSampleBuffer (noise, 0, noise.getNumSamples());
+
+    return file;
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    int maxBlockSize = 1024;
+    double sampleRate = 48000.0;
+    int numBlocks = 400;
+    int maxReports = 10;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const juce::String arg (argv[i]), value (argv[i + 1]);
+
+        if (arg == "--block")
+            maxBlockSize = juce::jlimit (16, 8192, value.getIntValue());
+        else if (arg == "--rate")
+            sampleRate = juce::jlimit (8000.0, 384000.0, value.getDoubleValue());
+        else if (arg == "--blocks")
+            numBlocks = juce::jmax (1, value.getIntValue());
+        else if (arg == "--reports")
+            maxReports = juce::jmax (0, value.getIntValue());
+        else
+        {
+            std::cerr << "Usage: ABComparisonRealtimeCheck [--block <size>] [--rate <Hz>] [--blocks <n>] [--reports <n>]" << std::endl;
+            return 1;
+        }
+    }
+
+    RealtimeChecker::setMaxReports (maxReports);
+
+    AbcomparisonAudioProcessor processor;
+    TransportPlayHead playHead;
+    playHead.sampleRate = sampleRate;
+    processor.setPlayHead (&playHead);
+    processor.setRateAndBufferSizeDetails (sampleRate, maxBlockSize);
+    processor.prepareToPlay (sampleRate, maxBlockSize);
+
+    const auto testFile = writeTestFile (sampleRate);
+
+    const Scenario scenarios[] =
+    {
+        { "exclusive solo, automated selection",
+          [] (auto& p) { automate (p, "switchMode", 0.0f); },
+          [] (auto& p, int block, auto&) { if (block % 7 == 0) automate (p, "selectedChoice", static_cast<float> (block / 7 % 5)); } },
+
+        { "toggle mode, automated choices",
+          [] (auto& p) { automate (p, "switchMode", 1.0f); },
+          [] (auto& p, int block, auto&) { if (block % 5 == 0) automate (p, "choiceState" + juce::String (block / 5 % 5), block % 2 == 0 ? 1.0f : 0.0f); } },
+
+        { "clicks from the editor",
+          [] (auto& p) { automate (p, "fadeTime", 20.0f); },
+          [] (auto& p, int block, auto&) { if (block % 9 == 0) p.switchChoice (block % 4); } },
+
+        { "MIDI notes and program changes",
+          [] (auto& p) { automate (p, "switchMode", 0.0f); p.storeSnapshot (0); automate (p, "switchMode", 1.0f); p.storeSnapshot (1); },
+          [] (auto&, int block, auto& midi)
+          {
+              if (block % 6 == 0)
+                  midi.addEvent (juce::MidiMessage::noteOn (1, AbcomparisonAudioProcessor::midiNoteOfFirstChoice + block % 5, 1.0f), 3);
+              if (block % 31 == 0)
+                  midi.addEvent (juce::MidiMessage::programChange (1, block / 31 % 2), 0);
+          } },
+
+        { "snapshots recalled by automation and from the editor",
+          {},
+          [] (auto& p, int block, auto&)
+          {
+              if (block % 23 == 0)
+                  automate (p, "snapshot", 1.0f + block / 23 % 2);
+              if (block % 37 == 0)
+                  p.recallSnapshot (block / 37 % 2);
+          } },
+
+        { "fade times and zero-crossing switches",
+          [] (auto& p) { automate (p, "zeroCrossingSwitch", 1.0f); automate (p, "switchMode", 0.0f); },
+          [] (auto& p, int block, auto&)
+          {
+              if (block % 11 == 0)
+                  automate (p, "fadeTime", static_cast<float> (block % 3 * 40));
+              if (block % 4 == 0)
+                  automate (p, "selectedChoice", static_cast<float> (block / 4 % 3));
+          } },
+
+        { "fold-down presets",
+          [] (auto& p) { automate (p, "zeroCrossingSwitch", 0.0f); automate (p, "channelSize", 5.0f); p.setFoldDownMatrix ("0.5 0.5 0 0 0 0; 0 0 0.5 0.5 0 0"); },
+          [] (auto& p, int block, auto&) { if (block % 13 == 0) automate (p, "foldDown", static_cast<float> (block / 13 % FoldDownPresets::numPresets)); } },
+
+        { "quantized switches",
+          [] (auto& p) { automate (p, "foldDown", 0.0f); automate (p, "channelSize", 1.0f); automate (p, "gridLength", 100.0f); },
+          [] (auto& p, int block, auto&)
+          {
+              if (block % 17 == 0)
+                  automate (p, "quantization", static_cast<float> (block / 17 % 4));
+              if (block % 3 == 0)
+                  automate (p, "selectedChoice", static_cast<float> (block / 3 % 4));
+          } },
+
+        { "auto-cycle",
+          [] (auto& p) { automate (p, "quantization", 0.0f); automate (p, "cycleInterval", 1.0f); p.setCycleOrder ("3 1 2"); },
+          [] (auto& p, int block, auto&)
+          {
+              if (block % 50 == 0)
+                  automate (p, "autoCycle", static_cast<float> (block / 50 % 4));
+              if (block % 71 == 0)
+                  automate (p, "cycleUnit", static_cast<float> (block / 71 % 2));
+          } },
+
+        { "difference mode",
+          [] (auto& p) { automate (p, "autoCycle", 0.0f); },
+          [] (auto& p, int block, auto&)
+          {
+              if (block % 19 == 0)
+                  automate (p, "difference", static_cast<float> (block / 19 % 2));
+              if (block % 29 == 0)
+                  automate (p, "differenceB", static_cast<float> (1 + block / 29 % 3));
+              automate (p, "differenceGain", static_cast<float> (block % 40));
+          } },
+
+        { "trim, polarity and delay",
+          [] (auto& p) { automate (p, "difference", 0.0f); automate (p, "switchMode", 1.0f); },
+          [] (auto& p, int block, auto&)
+          {
+              // the settings come from the message thread, which runs between the blocks here
+              if (block % 41 == 0)
+              {
+                  p.setChoiceTrims (block % 2 == 0 ? "0 -3 1.5" : "");
+                  p.setInvertedChoices (block % 2 == 0 ? "2" : "");
+                  p.setChoiceDelays (block % 2 == 0 ? "0 64 2000" : "0 0 0");
+              }
+              if (block % 5 == 0)
+                  automate (p, "choiceState" + juce::String (block / 5 % 3), block % 2 == 0 ? 1.0f : 0.0f);
+          } },
+
+        { "analyzer",
+          [] (auto& p) { p.getAnalyzerTap().setActive (true); p.getAnalyzerTap().setReferenceChoice (2); },
+          [] (auto& p, int block, auto&) { if (block % 8 == 0) p.getAnalyzerTap().discard(); } },
+
+        { "file players",
+          [&testFile] (auto& p) { p.getAnalyzerTap().setActive (false); p.loadFile (1, testFile); p.loadFile (3, testFile); },
+          [] (auto& p, int block, auto&) { if (block % 10 == 0) p.switchChoice (block / 10 % 4); } },
+
+        { "number of choices and channel size",
+          [] (auto& p) { p.unloadFile (1); p.unloadFile (3); },
+          [] (auto& p, int block, auto&)
+          {
+              if (block % 43 == 0)
+                  automate (p, "numberOfChoices", static_cast<float> (block / 43 % 6));
+              if (block % 53 == 0)
+                  automate (p, "channelSize", static_cast<float> (block / 53 % 4));
+          } },
+    };
+
+    juce::AudioBuffer<float> buffer (juce::jmax (processor.getTotalNumInputChannels(), processor.getTotalNumOutputChannels()), maxBlockSize);
+    juce::MidiBuffer midi;
+    juce::Random random (42);
+    bool failed = false;
+
+    for (const auto& scenario : scenarios)
+    {
+        if (scenario.setUp)
+            scenario.setUp (processor);
+
+        const int violationsBefore = RealtimeChecker::getNumViolations();
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            const int numSamples = random.nextInt ({ 1, maxBlockSize + 1 });
+
+            midi.clear();
+            scenario.perBlock (processor, block, midi);
+
+            for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+                for (int i = 0; i < numSamples; ++i)
+                    buffer.setSample (ch, i, 0.2f * random.nextFloat() - 0.1f);
+
+            juce::AudioBuffer<float> hostBlock (buffer.getArrayOfWritePointers(), buffer.getNumChannels(), numSamples);
+            processor.processBlock (hostBlock, midi);
+            playHead.timeInSamples += numSamples;
+
+            // the processor's timer, every 50ms or so
+            if (block % 4 == 0)
+                processor.timerCallback();
+        }
+
+        const int violations = RealtimeChecker::getNumViolations() - violationsBefore;
+        std::cout << (violations == 0 ? "ok    " : "FAILED") << "  " << scenario.name;
+        if (violations > 0)
+            std::cout << " (" << violations << " violations)";
+
+        std::cout << std::endl;
+        failed = failed || violations > 0;
+    }
+
+    processor.releaseResources();
+    processor.setPlayHead (nullptr);
+    testFile.deleteFile();
+
+    return failed ? 1 : 0;
+}
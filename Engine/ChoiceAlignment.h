@@ -0,0 +1,282 @@
+/*
+==============================================================================
+
+ABComparison Plug-in
+Copyright (C) 2018 - Daniel Rudrich
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+==============================================================================
+*/
+
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+/** Level, polarity and time alignment of the choices, for fair comparisons.
+
+    Trim and polarity are a constant factor, which the mixer folds into the gain ramp of the
+    crossfade. The delay is applied by the mixer as well, reading the source a few samples back;
+    only the last `delay` samples of each block are kept for the next one.
+
+    The settings are given as text:
+        trims       dB per choice, in the order of the choices, e.g. "0 -1.5 0.3"
+        inverted    the choices with inverted polarity, e.g. "2 4"
+        delays      samples per choice, in the order of the choices, e.g. "0 0 128"
+
+    Each of the maxChoices choices keeps a delay line of maxChannels channels once it is delayed.
+*/
+template <int maxChoices, int maxChannels>
+class ChoiceAlignment
+{
+public:
+    static constexpr int maxDelay = 4096; // in samples
+
+    ChoiceAlignment()
+    {
+        std::fill (std::begin (activeGains), std::end (activeGains), 1.0f);
+    }
+
+    //==============================================================================
+    /** Message thread: the setters return false if the text couldn't be parsed. */
+    bool setTrims (const juce::String& text)
+    {
+        float values[maxChoices] = {};
+        if (! parseTrims (text, values))
+            return false;
+
+        const juce::SpinLock::ScopedLockType lock (settingsLock);
+        std::copy (std::begin (values), std::end (values), std::begin (trims));
+        trimsText = text.trim();
+        ++version;
+        return true;
+    }
+
+    bool setInvertedChoices (const juce::String& text)
+    {
+        bool newInverted[maxChoices] = {};
+        if (! parseInvertedChoices (text, newInverted))
+            return false;
+
+        const juce::SpinLock::ScopedLockType lock (settingsLock);
+        std::copy (std::begin (newInverted), std::end (newInverted), std::begin (inverted));
+        invertedText = text.trim();
+        ++version;
+        return true;
+    }
+
+    bool setDelays (const juce::String& text)
+    {
+        float values[maxChoices] = {};
+        if (! parseValues (text, values, 0.0f, maxDelay, true))
+            return false;
+
+        // the delay lines are allocated here and kept, the audio thread only uses them once it has a delay
+        for (int choice = 0; choice < maxChoices; ++choice)
+        {
+            if (values[choice] > 0.0f && delayLines[choice] == nullptr)
+            {
+                delayLines[choice] = std::make_unique<juce::AudioBuffer<float>> (maxChannels, maxDelay);
+                delayLines[choice]->clear();
+            }
+        }
+
+        const juce::SpinLock::ScopedLockType lock (settingsLock);
+        for (int choice = 0; choice < maxChoices; ++choice)
+            delays[choice] = static_cast<int> (values[choice]);
+
+        delaysText = text.trim();
+        ++version;
+        return true;
+    }
+
+    juce::String getTrims() const           { const juce::SpinLock::ScopedLockType lock (settingsLock); return trimsText; }
+    juce::String getInvertedChoices() const { const juce::SpinLock::ScopedLockType lock (settingsLock); return invertedText; }
+    juce::String getDelays() const          { const juce::SpinLock::ScopedLockType lock (settingsLock); return delaysText; }
+
+    /** Message thread: the trims in dB and the polarities, e.g. for a snapshot. */
+    void getTrimsAndPolarities (float (&trimsInDb)[maxChoices], bool (&invertedChoices)[maxChoices]) const
+    {
+        const juce::SpinLock::ScopedLockType lock (settingsLock);
+        std::copy (std::begin (trims), std::end (trims), std::begin (trimsInDb));
+        std::copy (std::begin (inverted), std::end (inverted), std::begin (invertedChoices));
+    }
+
+    //==============================================================================
+    /** Conversions between the text and the values, e.g. for snapshots; the parsers return false if the text is invalid. */
+    static bool parseTrims (const juce::String& text, float (&trimsInDb)[maxChoices])
+    {
+        std::fill (std::begin (trimsInDb), std::end (trimsInDb), 0.0f);
+        return parseValues (text, trimsInDb, -60.0f, 60.0f, false);
+    }
+
+    static bool parseInvertedChoices (const juce::String& text, bool (&invertedChoices)[maxChoices])
+    {
+        float values[maxChoices] = {};
+        if (! parseValues (text, values, 1.0f, maxChoices, true))
+            return false;
+
+        std::fill (std::begin (invertedChoices), std::end (invertedChoices), false);
+        for (auto value : values)
+            if (value > 0.0f)
+                invertedChoices[static_cast<int> (value) - 1] = true;
+
+        return true;
+    }
+
+    static juce::String formatTrims (const float (&trimsInDb)[maxChoices])
+    {
+        // up to the last trimmed choice
+        int numTrimmed = maxChoices;
+        while (numTrimmed > 0 && trimsInDb[numTrimmed - 1] == 0.0f)
+            --numTrimmed;
+
+        juce::StringArray tokens;
+        for (int choice = 0; choice < numTrimmed; ++choice)
+            tokens.add (juce::String (trimsInDb[choice], 3).trimCharactersAtEnd ("0").trimCharactersAtEnd ("."));
+
+        return tokens.joinIntoString (" ");
+    }
+
+    static juce::String formatInvertedChoices (const bool (&invertedChoices)[maxChoices])
+    {
+        juce::StringArray tokens;
+        for (int choice = 0; choice < maxChoices; ++choice)
+            if (invertedChoices[choice])
+                tokens.add (juce::String (choice + 1));
+
+        return tokens.joinIntoString (" ");
+    }
+
+    //==============================================================================
+    /** Audio thread: takes over changed settings, a changed delay starts with silence. */
+    void update()
+    {
+        if (version.load() == activeVersion)
+            return;
+
+        // the settings are only changed while the lock is held, we'll try again next block
+        const juce::SpinLock::ScopedTryLockType lock (settingsLock);
+        if (! lock.isLocked())
+            return;
+
+        applyTrimsAndPolarities (trims, inverted);
+
+        for (int choice = 0; choice < maxChoices; ++choice)
+        {
+            if (delays[choice] != activeDelays[choice])
+            {
+                activeDelays[choice] = delays[choice];
+                if (activeDelays[choice] > 0)
+                    delayLines[choice]->clear (0, activeDelays[choice]);
+            }
+        }
+
+        activeVersion = version.load();
+    }
+
+    /** Audio thread: applies trims and polarities right away, e.g. from a snapshot. The settings
+        still have to follow on the message thread, the next changed setting replaces these. */
+    void applyTrimsAndPolarities (const float (&trimsInDb)[maxChoices], const bool (&invertedChoices)[maxChoices]) noexcept
+    {
+        for (int choice = 0; choice < maxChoices; ++choice)
+            activeGains[choice] = juce::Decibels::decibelsToGain (trimsInDb[choice], -100.0f) * (invertedChoices[choice] ? -1.0f : 1.0f);
+    }
+
+    float getGain (const int choice) const noexcept { return activeGains[choice]; }
+    int getDelay (const int choice) const noexcept { return activeDelays[choice]; }
+
+    /** Audio thread: writes (or adds) the delayed source with a gain ramp, startSample is relative to the block. */
+    void render (const int choice, const int channel, const float* source, float* dest,
+                 const int startSample, const int numSamples, const float startGain, const float endGain, const bool add) const
+    {
+        const int delay = activeDelays[choice];
+
+        // the first `delay` samples of the block come from the previous block
+        const int numFromHistory = juce::jlimit (0, numSamples, delay - startSample);
+        const float splitGain = startGain + (endGain - startGain) * numFromHistory / numSamples;
+
+        const float* history = delayLines[choice]->getReadPointer (channel);
+        renderWithRamp (dest + startSample, history + startSample, numFromHistory, startGain, splitGain, add);
+        renderWithRamp (dest + startSample + numFromHistory, source + startSample + numFromHistory - delay,
+                        numSamples - numFromHistory, splitGain, endGain, add);
+    }
+
+    /** Audio thread: keeps the end of the block for the next one, a nullptr source is silence. */
+    void pushBlock (const int choice, const int channel, const float* source, const int numSamples)
+    {
+        const int delay = activeDelays[choice];
+        float* history = delayLines[choice]->getWritePointer (channel);
+
+        const int numKept = juce::jmax (0, delay - numSamples);
+        const int numNew = delay - numKept;
+        std::memmove (history, history + delay - numKept, static_cast<size_t> (numKept) * sizeof (float));
+
+        if (source != nullptr)
+            juce::FloatVectorOperations::copy (history + numKept, source + numSamples - numNew, numNew);
+        else
+            juce::FloatVectorOperations::clear (history + numKept, numNew);
+    }
+
+private:
+    static bool parseValues (const juce::String& text, float (&values)[maxChoices], float minValue, float maxValue, bool integers)
+    {
+        auto tokens = juce::StringArray::fromTokens (text, " ,;", "");
+        tokens.removeEmptyStrings();
+
+        if (tokens.size() > maxChoices)
+            return false;
+
+        for (int i = 0; i < tokens.size(); ++i)
+        {
+            if (! tokens[i].containsOnly (integers ? "0123456789" : "0123456789.-+"))
+                return false;
+
+            values[i] = tokens[i].getFloatValue();
+            if (values[i] < minValue || values[i] > maxValue)
+                return false;
+        }
+
+        return true;
+    }
+
+    static void renderWithRamp (float* dest, const float* source, const int numSamples, float gain, const float endGain, const bool add) noexcept
+    {
+        if (numSamples <= 0)
+            return;
+
+        const float increment = (endGain - gain) / numSamples;
+        for (int i = 0; i < numSamples; ++i)
+        {
+            dest[i] = (add ? dest[i] : 0.0f) + source[i] * gain;
+            gain += increment;
+        }
+    }
+
+    // audio thread
+    float activeGains[maxChoices];
+    int activeDelays[maxChoices] = {};
+    int activeVersion = -1;
+
+    // message thread, the delay lines are allocated by the message thread and used by the audio thread
+    mutable juce::SpinLock settingsLock;
+    float trims[maxChoices] = {};
+    bool inverted[maxChoices] = {};
+    int delays[maxChoices] = {};
+    juce::String trimsText, invertedText, delaysText;
+    std::atomic<int> version { 0 };
+    std::unique_ptr<juce::AudioBuffer<float>> delayLines[maxChoices];
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ChoiceAlignment)
+};
@@ -0,0 +1,275 @@
+/*
+==============================================================================
+
+ABComparison Plug-in
+Copyright (C) 2018 - Daniel Rudrich
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+==============================================================================
+*/
+
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+/** The fold-down presets, independent of the channel capacity. */
+struct FoldDownPresets
+{
+    enum Preset { off, stereo, surround51, mono, user, numPresets };
+
+    static juce::StringArray getPresetNames()
+    {
+        return { "Off", "Stereo", "5.1", "Mono", "User" };
+    }
+};
+
+/** Folds the mixed choices down to the monitoring layout, e.g. 7.1.4 to stereo.
+
+    The coefficients are precomputed by the audio thread whenever the preset, the channel size or
+    the user matrix change; process() then only runs over the non-zero coefficients, one
+    vectorised multiply-add per coefficient.
+
+    The presets assume the channel order L R C LFE Ls Rs [Lb Rb] [Ltf Rtf Ltb Rtb], which is
+    recognised for 6 (5.1), 8 (7.1), 10 (5.1.4) and 12 (7.1.4) channels. Other channel sizes are
+    passed through, limited to the channel count of the preset.
+
+    The user matrix is given as text, one row per output channel, e.g. "0.5 0.5; 1 -1".
+    Without a user matrix, the user preset passes all channels through.
+    Up to maxChannels channels are folded down.
+*/
+template <int maxChannels>
+class FoldDownMatrix : public FoldDownPresets
+{
+public:
+    //==============================================================================
+    /** Message thread: sets the user matrix, returns false if the text couldn't be parsed. */
+    bool setUserMatrix (const juce::String& text)
+    {
+        float newMatrix[maxChannels][maxChannels] = {};
+        int numRows = 0;
+
+        auto rows = juce::StringArray::fromTokens (text.replaceCharacter ('\n', ';'), ";", "");
+        rows.trim();
+        rows.removeEmptyStrings();
+
+        if (rows.size() > maxChannels)
+            return false;
+
+        for (auto& row : rows)
+        {
+            auto values = juce::StringArray::fromTokens (row, " ,\t", "");
+            values.removeEmptyStrings();
+
+            if (values.size() > maxChannels)
+                return false;
+
+            for (int in = 0; in < values.size(); ++in)
+            {
+                if (! values[in].containsOnly ("0123456789.-+eE"))
+                    return false;
+
+                newMatrix[numRows][in] = values[in].getFloatValue();
+            }
+
+            ++numRows;
+        }
+
+        {
+            const juce::SpinLock::ScopedLockType lock (userMatrixLock);
+            std::copy (&newMatrix[0][0], &newMatrix[0][0] + maxChannels * maxChannels, &userMatrix[0][0]);
+            userMatrixRows = numRows;
+            userMatrixText = text.trim();
+        }
+
+        ++userMatrixVersion;
+        return true;
+    }
+
+    juce::String getUserMatrix() const
+    {
+        const juce::SpinLock::ScopedLockType lock (userMatrixLock);
+        return userMatrixText;
+    }
+
+    //==============================================================================
+    /** Audio thread: recomputes the coefficients if the configuration has changed. */
+    void update (const Preset newPreset, const int numInputs)
+    {
+        const int version = userMatrixVersion.load();
+        if (newPreset == preset && numInputs == numInputChannels && (newPreset != user || version == computedVersion))
+            return;
+
+        float matrix[maxChannels][maxChannels] = {};
+        int numRows = 0;
+
+        if (newPreset == user)
+        {
+            // the user matrix is only replaced while the lock is held, we'll try again next block
+            const juce::SpinLock::ScopedTryLockType lock (userMatrixLock);
+            if (! lock.isLocked())
+                return;
+
+            std::copy (&userMatrix[0][0], &userMatrix[0][0] + maxChannels * maxChannels, &matrix[0][0]);
+            numRows = userMatrixRows;
+            computedVersion = version;
+
+            if (numRows == 0) // no user matrix yet
+            {
+                numRows = numInputs;
+                for (int ch = 0; ch < numInputs; ++ch)
+                    matrix[ch][ch] = 1.0f;
+            }
+        }
+        else if (newPreset != off)
+            numRows = computePresetMatrix (newPreset, numInputs, matrix);
+
+        preset = newPreset;
+        numInputChannels = numInputs;
+        numOutputChannels = numRows;
+
+        for (int out = 0; out < numRows; ++out)
+        {
+            numTerms[out] = 0;
+            for (int in = 0; in < numInputs; ++in)
+            {
+                if (matrix[out][in] != 0.0f)
+                {
+                    termInputs[out][numTerms[out]] = in;
+                    termGains[out][numTerms[out]] = matrix[out][in];
+                    ++numTerms[out];
+                }
+            }
+        }
+    }
+
+    bool isActive() const noexcept { return preset != off; }
+    int getNumOutputChannels() const noexcept { return numOutputChannels; }
+
+    /** Audio thread: writes the folded-down input to the output, which must not share channels with the input. */
+    void process (const float* const* input, float* const* output, const int startSample, const int numSamples) const
+    {
+        for (int out = 0; out < numOutputChannels; ++out)
+        {
+            float* dest = output[out] + startSample;
+
+            if (numTerms[out] == 0)
+            {
+                juce::FloatVectorOperations::clear (dest, numSamples);
+                continue;
+            }
+
+            juce::FloatVectorOperations::copyWithMultiply (dest, input[termInputs[out][0]] + startSample, termGains[out][0], numSamples);
+            for (int term = 1; term < numTerms[out]; ++term)
+                juce::FloatVectorOperations::addWithMultiply (dest, input[termInputs[out][term]] + startSample, termGains[out][term], numSamples);
+        }
+    }
+
+private:
+    enum Speaker { L, R, C, LFE, Ls, Rs, Lb, Rb, Ltf, Rtf, Ltb, Rtb, numSpeakers };
+
+    static int computePresetMatrix (const Preset preset, const int numInputs, float (&matrix)[maxChannels][maxChannels])
+    {
+        int speakerOfChannel[maxChannels];
+        if (! getLayout (numInputs, speakerOfChannel))
+        {
+            // unknown layout: pass through as many channels as the preset has
+            const int numRows = juce::jmin (numInputs, preset == stereo ? 2 : preset == surround51 ? 6 : 1);
+            for (int ch = 0; ch < numRows; ++ch)
+                matrix[ch][ch] = 1.0f;
+
+            return numRows;
+        }
+
+        constexpr float minus3dB = juce::MathConstants<float>::sqrt2 * 0.5f;
+
+        // ITU-R BS.775 style downmix coefficients, the LFE is dropped for stereo and mono
+        float speakerGains[6][numSpeakers] = {};
+        int numRows = 0;
+
+        if (preset == surround51)
+        {
+            numRows = 6;
+            const Speaker outputs[] = { L, R, C, LFE, Ls, Rs };
+            for (int out = 0; out < numRows; ++out)
+                speakerGains[out][outputs[out]] = 1.0f;
+
+            if (numInputs == 8 || numInputs == 12) // sides and backs become the surrounds
+                speakerGains[4][Ls] = speakerGains[5][Rs] = speakerGains[4][Lb] = speakerGains[5][Rb] = minus3dB;
+
+            speakerGains[0][Ltf] = speakerGains[1][Rtf] = minus3dB;
+            speakerGains[4][Ltb] = speakerGains[5][Rtb] = minus3dB;
+        }
+        else
+        {
+            numRows = 2;
+            speakerGains[0][L] = speakerGains[1][R] = 1.0f;
+            speakerGains[0][C] = speakerGains[1][C] = minus3dB;
+            for (auto s : { Ls, Lb, Ltf, Ltb })
+                speakerGains[0][s] = minus3dB;
+            for (auto s : { Rs, Rb, Rtf, Rtb })
+                speakerGains[1][s] = minus3dB;
+
+            if (preset == mono)
+            {
+                numRows = 1;
+                for (int s = 0; s < numSpeakers; ++s)
+                    speakerGains[0][s] = 0.5f * (speakerGains[0][s] + speakerGains[1][s]);
+            }
+        }
+
+        for (int out = 0; out < numRows; ++out)
+            for (int in = 0; in < numInputs; ++in)
+                matrix[out][in] = speakerGains[out][speakerOfChannel[in]];
+
+        return numRows;
+    }
+
+    static bool getLayout (const int numInputs, int (&speakerOfChannel)[maxChannels])
+    {
+        const int order512[] = { L, R, C, LFE, Ls, Rs, Ltf, Rtf, Ltb, Rtb };
+        switch (numInputs)
+        {
+            case 6: case 8: case 12:
+                for (int ch = 0; ch < numInputs; ++ch)
+                    speakerOfChannel[ch] = ch;
+                return true;
+
+            case 10:
+                std::copy (std::begin (order512), std::end (order512), speakerOfChannel);
+                return true;
+
+            default:
+                return false;
+        }
+    }
+
+    // audio thread
+    Preset preset = off;
+    int numInputChannels = 0;
+    int numOutputChannels = 0;
+    int computedVersion = -1;
+    int numTerms[maxChannels] = {};
+    int termInputs[maxChannels][maxChannels] = {};
+    float termGains[maxChannels][maxChannels] = {};
+
+    // message thread
+    mutable juce::SpinLock userMatrixLock;
+    float userMatrix[maxChannels][maxChannels] = {};
+    int userMatrixRows = 0;
+    juce::String userMatrixText;
+    std::atomic<int> userMatrixVersion { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FoldDownMatrix)
+};
@@ -0,0 +1,26 @@
+/*
+==============================================================================
+
+ABComparison Plug-in
+Copyright (C) 2018 - Daniel Rudrich
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+==============================================================================
+*/
+
+#include "SwitchEngine.h"
+
+// the capacity of the plug-in and the tools, see ABCOMPARISON_MAX_CHOICES and ABCOMPARISON_MAX_CHANNELS
+template class SwitchEngine<ABCOMPARISON_MAX_CHOICES, ABCOMPARISON_MAX_CHANNELS>;
@@ -0,0 +1,596 @@
+/*
+==============================================================================
+
+ABComparison Plug-in
+Copyright (C) 2018 - Daniel Rudrich
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+==============================================================================
+*/
+
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "ChoiceAlignment.h"
+#include "FoldDownMatrix.h"
+
+/** The capacity of the plug-in and the tools: the number of choices and their maximum channel size.
+    The processor, the editor and SwitchEngine.cpp take it from here, CMake sets it with
+    ABCOMPARISON_MAX_CHOICES and ABCOMPARISON_MAX_CHANNELS.
+*/
+#ifndef ABCOMPARISON_MAX_CHOICES
+ #define ABCOMPARISON_MAX_CHOICES 32
+#endif
+
+#ifndef ABCOMPARISON_MAX_CHANNELS
+ #define ABCOMPARISON_MAX_CHANNELS 32
+#endif
+
+/** The switching, fade and mix engine: crossfades between up to maxChoices choices of up to
+    maxChannels channels each, with zero-crossing switches, trim, polarity and delay, the
+    difference mode and the monitoring fold-down.
+
+    It knows nothing about parameters, the GUI or OSC. Its owner decides which choices play and
+    when, and points the engine to the channels of each choice. On the audio thread, per block:
+
+        setSource()                 for every choice and channel, nullptr for silence
+        beginBlock()
+        render()                    for each sub-block, with setChoice() between them
+        endBlock()
+
+    The mix is written to the first channels of the block's buffer, which may also hold the
+    sources. The engine for the configured capacity is compiled in SwitchEngine.cpp, other
+    capacities are instantiated where they are used.
+*/
+template <int maxChoices, int maxChannels>
+class SwitchEngine
+{
+public:
+    using Alignment = ChoiceAlignment<maxChoices, maxChannels>;
+    using FoldDown = FoldDownMatrix<maxChannels>;
+
+    static constexpr int zeroCrossingFadeLength = 16; // micro-fade at the switch point, in samples
+    static constexpr float silenceThreshold = 1.0e-15f; // about -300 dBFS, digital silence and denormals
+    static constexpr int tileCacheSize = 128 * 1024; // bytes of sources and mix the mixer keeps in the cache at once
+    static constexpr int minTileLength = 64;
+    static constexpr int maxTileLength = 2048;
+
+    SwitchEngine() = default;
+
+    //==============================================================================
+    /** Allocates the buffers for blocks of up to maximumBlockSize samples, not real-time safe. */
+    void prepare (double newSampleRate, int maximumBlockSize);
+    double getSampleRate() const noexcept { return sampleRate; }
+
+    /** Fade length in samples of all choices, a running fade continues with the new length. */
+    void setFadeLength (int numSamples);
+    int getFadeLength() const noexcept { return fadeLength; }
+
+    /** Starts or stops the choice without a fade, e.g. after prepare(). */
+    void resetChoice (int choice, bool shouldPlay);
+
+    /** Fades the choice in or out, from the next render() on. */
+    void setChoice (int choice, bool shouldPlay);
+
+    /** Holds a switch until the quietest point of the sub-block, and switches there with a micro-fade. */
+    void setZeroCrossingSwitch (bool shouldSwitchAtZeroCrossings) noexcept { zeroCrossingSwitch = shouldSwitchAtZeroCrossings; }
+
+    /** The output fades to (A - B) times the residual gain, in and out with the fade length, but at least in 10ms.
+        A difference of a choice with itself would be silent, so with A == B the mix keeps playing. */
+    void setDifference (bool shouldBeActive, int choiceA, int choiceB, float newResidualGain);
+    void resetDifference (bool shouldBeActive, float newResidualGain);
+
+    /** Samples per tile of the mixer, 0 (the default) sizes the tiles for the cache. */
+    void setMixTileLength (int numSamples) noexcept { mixTileLength = numSamples; }
+
+    //==============================================================================
+    void setSource (int choice, int channel, const float* source) noexcept { inputs[choice][channel] = source; }
+    const float* getSource (int choice, int channel) const noexcept { return inputs[choice][channel]; }
+
+    /** Takes over the sources and changed settings, and finds the sources on output channels which the mix would
+        overwrite before reading them. Only the first numOutputChannels channels of the buffer are written, the ones
+        after them are inputs only. Nothing is read here, the sources are only touched tile by tile while mixing. */
+    void beginBlock (juce::AudioBuffer<float>& buffer, int numChannels, int numOutputChannels, int numChoices, FoldDownPresets::Preset foldDownPreset);
+
+    /** Renders the sub-block into the buffer given to beginBlock(). */
+    void render (int startSample, int numSamples);
+
+    /** Keeps the end of the delayed sources for the next block. */
+    void endBlock();
+
+    /** The channels written by the last block, the ones after them are left as they were. */
+    int getNumOutputChannels() const noexcept { return foldingDown ? foldDown.getNumOutputChannels() : juce::jmin (stride, writableChannels); }
+
+    /** False if none of the choice's channels carried a signal for a while, from any thread. */
+    bool choiceHasSignal (int choice) const noexcept { return hasSignal[choice].load(); }
+
+    //==============================================================================
+    /** Message thread: trim, polarity and delay, and the user fold-down matrix. */
+    Alignment& getAlignment() noexcept { return alignment; }
+    const Alignment& getAlignment() const noexcept { return alignment; }
+    FoldDown& getFoldDown() noexcept { return foldDown; }
+    const FoldDown& getFoldDown() const noexcept { return foldDown; }
+
+private:
+    void protectOverwrittenSources();
+    void copyProtectedSources (int startSample, int numSamples);
+    bool hasSignalInTile (int choice, const float* source, int startSample, int numSamples);
+    void renderChoices (int startSample, int numSamples);
+    void renderTile (int startSample, int numSamples);
+    int findSwitchPoint (const bool* switching, int startSample, int numSamples, int fadeSamples);
+    void setChoiceFadeLength (int choice, int numSamples);
+
+    double sampleRate = 48000.0;
+    juce::LinearSmoothedValue<float> gains[maxChoices];
+    float renderedTargets[maxChoices] = {};
+    int fadeLength = 0;
+    bool zeroCrossingSwitch = false;
+
+    // the block being rendered, between beginBlock() and endBlock()
+    juce::AudioBuffer<float>* output = nullptr;
+    int stride = 1;
+    int writableChannels = 1;
+    int nChoices = 0;
+    int blockLength = 0;
+
+    // the channels each choice is read from, nullptr for silence, as set and as read by the mixer
+    const float* inputs[maxChoices][maxChannels] = {};
+    const float* sources[maxChoices][maxChannels] = {};
+
+    // input activity, checked while mixing; the channels of inactive choices are checked one choice per block
+    std::atomic<bool> hasSignal[maxChoices] {};
+    bool checkedInBlock[maxChoices] = {};
+    bool signalInBlock[maxChoices] = {};
+    juce::int64 lastSignalAt[maxChoices] = {};
+    juce::int64 samplesProcessed = 0;
+    int inactiveChoiceToCheck = 0;
+
+    juce::AudioBuffer<float> switchPointBuffer;
+
+    // monitoring fold-down, the choices are mixed into the mix buffer first if it's active
+    FoldDown foldDown;
+    bool foldingDown = false;
+    juce::AudioBuffer<float> mixBuffer;
+
+    // difference mode: the output fades to A - B, with the residual gain
+    juce::LinearSmoothedValue<float> differenceMix, residualGain;
+    int differenceChoiceA = 0;
+    int differenceChoiceB = 1;
+
+    // trim, polarity and delay, applied by the mixer
+    Alignment alignment;
+
+    // copies of the sources on output channels, which the mix would overwrite before they are read;
+    // each tile is copied right before it's mixed
+    juce::AudioBuffer<float> protectedSourceBuffer;
+    const float* protectedInputs[maxChannels] = {};
+    int numProtectedSources = 0;
+
+    std::atomic<int> mixTileLength { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SwitchEngine)
+};
+
+//==============================================================================
+template <int maxChoices, int maxChannels>
+void SwitchEngine<maxChoices, maxChannels>::prepare (double newSampleRate, int maximumBlockSize)
+{
+    sampleRate = newSampleRate;
+
+    residualGain.reset (sampleRate, 0.05);
+
+    // the zero-crossing search looks at most 10ms into the block
+    switchPointBuffer.setSize (2, juce::jmax (zeroCrossingFadeLength, juce::roundToInt (sampleRate * 0.01)));
+    mixBuffer.setSize (maxChannels, maximumBlockSize);
+    protectedSourceBuffer.setSize (maxChannels, maximumBlockSize);
+}
+
+template <int maxChoices, int maxChannels>
+void SwitchEngine<maxChoices, maxChannels>::setFadeLength (int numSamples)
+{
+    fadeLength = numSamples;
+    for (int choice = 0; choice < maxChoices; ++choice)
+        setChoiceFadeLength (choice, fadeLength);
+}
+
+template <int maxChoices, int maxChannels>
+void SwitchEngine<maxChoices, maxChannels>::setChoiceFadeLength (int choice, int numSamples)
+{
+    // LinearSmoothedValue::reset() would jump to the target, so a running fade is restored afterwards
+    auto& gain = gains[choice];
+    const float currentGain = gain.getCurrentValue();
+    const float targetGain = gain.getTargetValue();
+
+    gain.reset (numSamples);
+    gain.setCurrentAndTargetValue (currentGain);
+    gain.setTargetValue (targetGain);
+}
+
+template <int maxChoices, int maxChannels>
+void SwitchEngine<maxChoices, maxChannels>::resetChoice (int choice, bool shouldPlay)
+{
+    gains[choice].reset (fadeLength);
+    gains[choice].setCurrentAndTargetValue (shouldPlay ? 1.0f : 0.0f);
+    renderedTargets[choice] = gains[choice].getTargetValue();
+}
+
+template <int maxChoices, int maxChannels>
+void SwitchEngine<maxChoices, maxChannels>::setChoice (int choice, bool shouldPlay)
+{
+    gains[choice].setTargetValue (shouldPlay ? 1.0f : 0.0f);
+}
+
+template <int maxChoices, int maxChannels>
+void SwitchEngine<maxChoices, maxChannels>::setDifference (bool shouldBeActive, int choiceA, int choiceB, float newResidualGain)
+{
+    differenceChoiceA = choiceA;
+    differenceChoiceB = choiceB;
+    residualGain.setTargetValue (newResidualGain);
+
+    const float target = shouldBeActive && choiceA != choiceB ? 1.0f : 0.0f;
+    if (target != differenceMix.getTargetValue())
+    {
+        // in and out of the difference with the fade time, but at least 10ms, so it never clicks
+        const float current = differenceMix.getCurrentValue();
+        differenceMix.reset (juce::jmax (fadeLength, juce::roundToInt (sampleRate * 0.01)));
+        differenceMix.setCurrentAndTargetValue (current);
+        differenceMix.setTargetValue (target);
+    }
+}
+
+template <int maxChoices, int maxChannels>
+void SwitchEngine<maxChoices, maxChannels>::resetDifference (bool shouldBeActive, float newResidualGain)
+{
+    differenceMix.setCurrentAndTargetValue (shouldBeActive ? 1.0f : 0.0f);
+    residualGain.setCurrentAndTargetValue (newResidualGain);
+}
+
+//==============================================================================
+template <int maxChoices, int maxChannels>
+void SwitchEngine<maxChoices, maxChannels>::beginBlock (juce::AudioBuffer<float>& buffer, int numChannels, int numOutputChannels, int numChoices,
+                                                        FoldDownPresets::Preset foldDownPreset)
+{
+    output = &buffer;
+    stride = juce::jlimit (1, maxChannels, numChannels);
+    writableChannels = juce::jlimit (0, buffer.getNumChannels(), numOutputChannels);
+    nChoices = juce::jlimit (1, maxChoices, numChoices);
+    blockLength = buffer.getNumSamples();
+
+    std::copy (&inputs[0][0], &inputs[0][0] + maxChoices * maxChannels, &sources[0][0]);
+
+    // choices switched on by an event within this block are checked from the tile they start playing in
+    inactiveChoiceToCheck = (inactiveChoiceToCheck + 1) % nChoices;
+    std::fill (std::begin (checkedInBlock), std::end (checkedInBlock), false);
+    std::fill (std::begin (signalInBlock), std::end (signalInBlock), false);
+
+    foldDown.update (foldDownPreset, stride);
+    foldingDown = foldDown.isActive() && blockLength <= mixBuffer.getNumSamples() && foldDown.getNumOutputChannels() <= writableChannels;
+    jassert (foldingDown == foldDown.isActive()); // block is larger than announced in prepare()
+
+    alignment.update();
+    protectOverwrittenSources();
+}
+
+template <int maxChoices, int maxChannels>
+void SwitchEngine<maxChoices, maxChannels>::endBlock()
+{
+    // also for inactive choices, so they start with the right samples when switched on
+    for (int choice = 0; choice < nChoices; ++choice)
+        if (alignment.getDelay (choice) > 0)
+            for (int ch = 0; ch < stride; ++ch)
+                alignment.pushBlock (choice, ch, sources[choice][ch], blockLength);
+
+    // an unchecked choice keeps its indicator until it is checked again
+    samplesProcessed += blockLength;
+    const auto holdTime = juce::jmax (static_cast<juce::int64> (sampleRate / 2), static_cast<juce::int64> (2 * nChoices * blockLength));
+
+    for (int choice = 0; choice < nChoices; ++choice)
+    {
+        if (! checkedInBlock[choice])
+            continue;
+
+        if (signalInBlock[choice])
+            lastSignalAt[choice] = samplesProcessed;
+
+        hasSignal[choice] = samplesProcessed - lastSignalAt[choice] < holdTime;
+    }
+
+    output = nullptr;
+}
+
+template <int maxChoices, int maxChannels>
+bool SwitchEngine<maxChoices, maxChannels>::hasSignalInTile (int choice, const float* source, int startSample, int numSamples)
+{
+    checkedInBlock[choice] = true;
+
+    const auto range = juce::FloatVectorOperations::findMinAndMax (source + startSample, numSamples);
+    const bool hasSignalInTile = juce::jmax (-range.getStart(), range.getEnd()) >= silenceThreshold;
+    signalInBlock[choice] = signalInBlock[choice] || hasSignalInTile;
+    return hasSignalInTile;
+}
+
+template <int maxChoices, int maxChannels>
+void SwitchEngine<maxChoices, maxChannels>::protectOverwrittenSources()
+{
+    // the output overwrites its channels sub-block by sub-block. A delayed choice reads back into earlier
+    // sub-blocks and keeps the end of the block, and without fold-down, the first choice overwrites the
+    // output before the other choices are read, e.g. their side-chain inputs behind a narrow main bus.
+    // Such sources are read from copies, filled tile by tile; only the first choice on its own channel is mixed in place.
+    auto& buffer = *output;
+    const int nWritten = getNumOutputChannels();
+    numProtectedSources = 0;
+
+    for (int choice = 0; choice < nChoices; ++choice)
+    {
+        const bool delayed = alignment.getDelay (choice) > 0;
+        if (! delayed && foldingDown)
+            continue;
+
+        for (int ch = 0; ch < stride; ++ch)
+        {
+            for (int outputChannel = 0; outputChannel < nWritten; ++outputChannel)
+            {
+                if (sources[choice][ch] != buffer.getReadPointer (outputChannel))
+                    continue;
+
+                if (! delayed && choice == 0 && outputChannel == ch)
+                    break;
+
+                jassert (numProtectedSources < protectedSourceBuffer.getNumChannels()); // at most one source per output channel
+                if (numProtectedSources < protectedSourceBuffer.getNumChannels() && blockLength <= protectedSourceBuffer.getNumSamples())
+                {
+                    protectedInputs[numProtectedSources] = sources[choice][ch];
+                    sources[choice][ch] = protectedSourceBuffer.getReadPointer (numProtectedSources++);
+                }
+
+                break;
+            }
+        }
+    }
+}
+
+template <int maxChoices, int maxChannels>
+void SwitchEngine<maxChoices, maxChannels>::copyProtectedSources (int startSample, int numSamples)
+{
+    for (int i = 0; i < numProtectedSources; ++i)
+        juce::FloatVectorOperations::copy (protectedSourceBuffer.getWritePointer (i, startSample), protectedInputs[i] + startSample, numSamples);
+}
+
+//==============================================================================
+template <int maxChoices, int maxChannels>
+void SwitchEngine<maxChoices, maxChannels>::render (int startSample, int numSamples)
+{
+    if (numSamples <= 0)
+        return;
+
+    bool switching[maxChoices];
+    bool anyChoiceSwitching = false;
+    for (int choice = 0; choice < nChoices; ++choice)
+    {
+        switching[choice] = gains[choice].isSmoothing() || gains[choice].getTargetValue() != renderedTargets[choice];
+        anyChoiceSwitching = anyChoiceSwitching || switching[choice];
+    }
+
+    if (zeroCrossingSwitch && anyChoiceSwitching)
+    {
+        // hold the switching choices at their old gain until the quietest point of the sub-block,
+        // and switch there with a micro-fade
+        float targets[maxChoices];
+        for (int choice = 0; choice < nChoices; ++choice)
+        {
+            if (! switching[choice])
+                continue;
+
+            targets[choice] = gains[choice].getTargetValue();
+            const float oldGain = gains[choice].isSmoothing() ? gains[choice].getCurrentValue() : renderedTargets[choice];
+            gains[choice].setCurrentAndTargetValue (oldGain);
+        }
+
+        const int microFadeLength = juce::jmin (zeroCrossingFadeLength, numSamples);
+        const int switchPoint = startSample + findSwitchPoint (switching, startSample, numSamples, microFadeLength);
+
+        renderChoices (startSample, switchPoint - startSample);
+
+        for (int choice = 0; choice < nChoices; ++choice)
+        {
+            if (! switching[choice])
+                continue;
+
+            gains[choice].reset (microFadeLength);
+            gains[choice].setTargetValue (targets[choice]);
+        }
+
+        renderChoices (switchPoint, startSample + numSamples - switchPoint);
+
+        for (int choice = 0; choice < nChoices; ++choice)
+            if (switching[choice])
+                setChoiceFadeLength (choice, fadeLength);
+    }
+    else
+        renderChoices (startSample, numSamples);
+
+    for (int choice = 0; choice < nChoices; ++choice)
+        renderedTargets[choice] = gains[choice].getTargetValue();
+}
+
+template <int maxChoices, int maxChannels>
+void SwitchEngine<maxChoices, maxChannels>::renderChoices (int startSample, int numSamples)
+{
+    if (numSamples <= 0)
+        return;
+
+    // in tiles across all channels and choices, so the mix (and the fold-down) work on samples which are still in the cache,
+    // instead of streaming the whole buffer through it once per choice; the gain ramps continue from tile to tile
+    int tileLength = mixTileLength.load();
+    if (tileLength <= 0)
+        tileLength = juce::jlimit (minTileLength, maxTileLength, tileCacheSize / static_cast<int> (sizeof (float) * (nChoices + 1) * stride)) & ~15;
+
+    tileLength = juce::jmin (tileLength, numSamples);
+    for (int offset = 0; offset < numSamples; offset += tileLength)
+        renderTile (startSample + offset, juce::jmin (tileLength, numSamples - offset));
+}
+
+template <int maxChoices, int maxChannels>
+void SwitchEngine<maxChoices, maxChannels>::renderTile (int startSample, int numSamples)
+{
+    if (numSamples <= 0)
+        return;
+
+    // with fold-down, the choices are mixed into the mix buffer and folded into the output right after,
+    // while the tile is still in the cache
+    auto& buffer = *output;
+    auto& mix = foldingDown ? mixBuffer : buffer;
+    const int nCh = foldingDown ? juce::jmin (mix.getNumChannels(), stride) : juce::jmin (writableChannels, stride);
+
+    // the sources the mix would overwrite are copied before anything is written, and silence is detected per tile
+    // while the sources are in the cache anyway, so no pass over the whole block streams them through it once more
+    copyProtectedSources (startSample, numSamples);
+
+    // the difference mode fades from the mix to A - B by adding to the gain ramps of A and B,
+    // trim and polarity are part of the gain ramps as well, so it all happens in one pass
+    const float mixStart = differenceMix.getCurrentValue();
+    const float mixEnd = differenceMix.skip (numSamples);
+    const float residualStart = mixStart * residualGain.getCurrentValue();
+    const float residualEnd = mixEnd * residualGain.skip (numSamples);
+
+    float startGains[maxChoices], endGains[maxChoices];
+    for (int choice = 0; choice < nChoices; ++choice)
+    {
+        const float sign = (choice == differenceChoiceA ? 1.0f : 0.0f) - (choice == differenceChoiceB ? 1.0f : 0.0f);
+        const float trim = alignment.getGain (choice);
+        startGains[choice] = trim * ((1.0f - mixStart) * gains[choice].getCurrentValue() + sign * residualStart);
+        endGains[choice] = trim * ((1.0f - mixEnd) * gains[choice].skip (numSamples) + sign * residualEnd);
+    }
+
+    // choice 0, rendered in place if it plays the input channels
+    // the delay is read from the sources, so the alignment needs no extra pass either
+    if (startGains[0] == 0.0f && endGains[0] == 0.0f)
+    {
+        for (int ch = 0; ch < nCh; ++ch)
+        {
+            if (inactiveChoiceToCheck == 0 && sources[0][ch] != nullptr)
+                hasSignalInTile (0, sources[0][ch], startSample, numSamples);
+
+            mix.clear (ch, startSample, numSamples);
+        }
+    }
+    else
+    {
+        const float startGain = startGains[0];
+        const float endGain = endGains[0];
+        const bool delayed = alignment.getDelay (0) > 0;
+
+        for (int ch = 0; ch < nCh; ++ch)
+        {
+            // a delayed choice still plays the end of the previous block, so it isn't skipped
+            const float* source = sources[0][ch];
+            if (source == nullptr || (! hasSignalInTile (0, source, startSample, numSamples) && ! delayed))
+                mix.clear (ch, startSample, numSamples);
+            else if (delayed)
+                alignment.render (0, ch, source, mix.getWritePointer (ch), startSample, numSamples, startGain, endGain, false);
+            else if (source == mix.getReadPointer (ch))
+                mix.applyGainRamp (ch, startSample, numSamples, startGain, endGain);
+            else
+                mix.copyFromWithRamp (ch, startSample, source + startSample, numSamples, startGain, endGain);
+        }
+    }
+
+    // remaining choices
+    for (int choice = 1; choice < nChoices; ++choice)
+    {
+        if (startGains[choice] != 0.0f || endGains[choice] != 0.0f)
+        {
+            const float startGain = startGains[choice];
+            const float endGain = endGains[choice];
+            const bool delayed = alignment.getDelay (choice) > 0;
+
+            for (int ch = 0; ch < nCh; ++ch)
+            {
+                if (const float* source = sources[choice][ch])
+                {
+                    if (! hasSignalInTile (choice, source, startSample, numSamples) && ! delayed)
+                        continue; // the mixer skips it
+
+                    if (delayed)
+                        alignment.render (choice, ch, source, mix.getWritePointer (ch), startSample, numSamples, startGain, endGain, true);
+                    else
+                        mix.addFromWithRamp (ch, startSample, source + startSample, numSamples, startGain, endGain);
+                }
+            }
+        }
+        else if (choice == inactiveChoiceToCheck)
+        {
+            for (int ch = 0; ch < nCh; ++ch)
+                if (const float* source = sources[choice][ch])
+                    hasSignalInTile (choice, source, startSample, numSamples);
+        }
+    }
+
+    if (foldingDown)
+        foldDown.process (mixBuffer.getArrayOfReadPointers(), buffer.getArrayOfWritePointers(), startSample, numSamples);
+}
+
+template <int maxChoices, int maxChannels>
+int SwitchEngine<maxChoices, maxChannels>::findSwitchPoint (const bool* switching, int startSample, int numSamples, int fadeSamples)
+{
+    const int searchLength = juce::jmin (numSamples, switchPointBuffer.getNumSamples());
+    if (searchLength <= fadeSamples)
+        return 0;
+
+    // nothing of the sub-block is mixed yet, but the copies of the protected sources have to be there
+    copyProtectedSources (startSample, searchLength);
+
+    // summed magnitude of all outgoing and incoming channels
+    auto* energy = switchPointBuffer.getWritePointer (0);
+    auto* magnitude = switchPointBuffer.getWritePointer (1);
+    juce::FloatVectorOperations::clear (energy, searchLength);
+
+    for (int choice = 0; choice < nChoices; ++choice)
+    {
+        if (! switching[choice])
+            continue;
+
+        for (int ch = 0; ch < stride; ++ch)
+        {
+            if (const float* source = sources[choice][ch])
+            {
+                juce::FloatVectorOperations::abs (magnitude, source + startSample, searchLength);
+                juce::FloatVectorOperations::add (energy, magnitude, searchLength);
+            }
+        }
+    }
+
+    // the micro-fade starts where it covers the least energy
+    float windowEnergy = 0.0f;
+    for (int i = 0; i < fadeSamples; ++i)
+        windowEnergy += energy[i];
+
+    float minEnergy = windowEnergy;
+    int switchPoint = 0;
+    for (int i = 1; i + fadeSamples <= searchLength; ++i)
+    {
+        windowEnergy += energy[i + fadeSamples - 1] - energy[i - 1];
+        if (windowEnergy < minEnergy)
+        {
+            minEnergy = windowEnergy;
+            switchPoint = i;
+        }
+    }
+
+    return switchPoint;
+}
+
+// compiled once per target, in SwitchEngine.cpp
+extern template class SwitchEngine<ABCOMPARISON_MAX_CHOICES, ABCOMPARISON_MAX_CHANNELS>;
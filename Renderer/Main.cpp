@@ -0,0 +1,354 @@
+/*
+ ==============================================================================
+
+ ABComparison Plug-in
+ Copyright (C) 2018 - Daniel Rudrich
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+ ==============================================================================
+ */
+
+/*
+ ===== ABComparisonRenderer =====
+ Renders an A/B comparison offline: the input files are the choices, a cue list
+ tells when to switch between them. The same AbcomparisonAudioProcessor as in the
+ plug-in does the switching, as fast as the disk allows.
+
+ Usage:
+    ABComparisonRenderer --cues <cues.json|cues.csv> --output <out.wav> [--block <size>] [--trace <trace.json>] <input1> <input2> ...
+
+ Cue list as JSON:
+    { "switchMode": "exclusive", "fadeTime": 50,
+      "cues": [ { "time": 0.0, "switch": [1] },
+                { "time": 4.5, "switch": [2], "fadeTime": 20 } ] }
+
+ Cue list as CSV, one cue per line, time in seconds:
+    0.0, mode, exclusive
+    0.0, fade, 50
+    0.0, switch, 1
+    4.5, switch, 2
+
+ 'switch' behaves like the OSC command: in exclusive solo mode it selects the choice,
+ in toggle mode it toggles it. Several choices can be given at once. All inputs have to
+ have the same sample rate, they aren't resampled.
+
+ --trace writes a Chrome trace of the rendering, if the tracer is compiled in (ABCOMPARISON_ENABLE_TRACING).
+ With the real-time checks compiled in (ABCOMPARISON_ENABLE_REALTIME_CHECKS), the renderer fails
+ if processBlock or parameterChanged allocated or locked while rendering.
+ */
+
+#include <cmath>
+#include <iostream>
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../Source/PluginProcessor.h"
+
+//==============================================================================
+struct Cue
+{
+    enum Type { switchChoices, fadeTime, switchMode };
+
+    double time;
+    Type type;
+    juce::Array<int> choices; // 1-based, like the OSC command
+    float value = 0.0f;
+};
+
+static void addCue (juce::Array<Cue>& cues, double time, const juce::String& command, const juce::var& value)
+{
+    if (command == "switch")
+    {
+        Cue cue { time, Cue::switchChoices };
+        if (auto* choices = value.getArray())
+            for (auto& choice : *choices)
+                cue.choices.add (static_cast<int> (choice));
+        else
+            cue.choices.add (static_cast<int> (value));
+
+        cues.add (cue);
+    }
+    else if (command == "fade" || command == "fadeTime")
+        cues.add ({ time, Cue::fadeTime, {}, static_cast<float> (value) });
+    else if (command == "mode" || command == "switchMode")
+        cues.add ({ time, Cue::switchMode, {}, value.toString().trim() == "toggle" ? 1.0f : 0.0f });
+    else
+        std::cerr << "Ignoring unknown cue command '" << command << "'" << std::endl;
+}
+
+static juce::Array<Cue> parseCueList (const juce::File& file)
+{
+    juce::Array<Cue> cues;
+
+    if (file.hasFileExtension ("json"))
+    {
+        const auto json = juce::JSON::parse (file);
+
+        for (auto command : { "switchMode", "fadeTime" })
+            if (json.hasProperty (command))
+                addCue (cues, 0.0, command, json[command]);
+
+        if (auto* list = json["cues"].getArray())
+            for (auto& entry : *list)
+                if (auto* object = entry.getDynamicObject())
+                    for (auto& property : object->getProperties())
+                        if (property.name.toString() != "time")
+                            addCue (cues, static_cast<double> (entry["time"]), property.name.toString(), property.value);
+    }
+    else
+    {
+        for (auto& line : juce::StringArray::fromLines (file.loadFileAsString()))
+        {
+            auto tokens = juce::StringArray::fromTokens (line, ",", "\"");
+            tokens.trim();
+            tokens.removeEmptyStrings();
+
+            if (tokens.size() < 3 || ! tokens[0].containsOnly ("0123456789.")) // skips empty lines and headers
+                continue;
+
+            juce::var value;
+            if (tokens.size() > 3)
+            {
+                for (int i = 2; i < tokens.size(); ++i)
+                    value.append (tokens[i].getIntValue());
+            }
+            else
+                value = tokens[2].containsOnly ("0123456789.") ? juce::var (tokens[2].getDoubleValue()) : juce::var (tokens[2]);
+
+            addCue (cues, tokens[0].getDoubleValue(), tokens[1], value);
+        }
+    }
+
+    std::stable_sort (cues.begin(), cues.end(), [] (const Cue& a, const Cue& b) { return a.time < b.time; });
+    return cues;
+}
+
+//==============================================================================
+static juce::RangedAudioParameter* getParameter (juce::AudioProcessor& processor, const juce::String& parameterID)
+{
+    for (auto* parameter : processor.getParameters())
+        if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*> (parameter))
+            if (ranged->paramID == parameterID)
+                return ranged;
+
+    jassertfalse;
+    return nullptr;
+}
+
+static void setParameter (juce::AudioProcessor& processor, const juce::String& parameterID, float value)
+{
+    if (auto* parameter = getParameter (processor, parameterID))
+        parameter->setValueNotifyingHost (parameter->convertTo0to1 (value));
+}
+
+static void applyCue (AbcomparisonAudioProcessor& processor, const Cue& cue)
+{
+    switch (cue.type)
+    {
+        case Cue::switchChoices:
+            for (auto choice : cue.choices)
+                processor.switchChoice (choice - 1);
+            break;
+
+        case Cue::fadeTime:
+            setParameter (processor, "fadeTime", cue.value);
+            break;
+
+        case Cue::switchMode:
+            setParameter (processor, "switchMode", cue.value);
+            break;
+    }
+}
+
+static std::unique_ptr<juce::AudioFormatReader> openInput (juce::AudioFormatManager& formatManager, const juce::File& file)
+{
+    if (auto* format = formatManager.findFormatForFileExtension (file.getFileExtension()))
+    {
+        std::unique_ptr<juce::MemoryMappedAudioFormatReader> mappedReader (format->createMemoryMappedReader (file));
+        if (mappedReader != nullptr && mappedReader->mapEntireFile())
+            return mappedReader;
+    }
+
+    return std::unique_ptr<juce::AudioFormatReader> (formatManager.createReaderFor (file));
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::File cueFile, outputFile, traceFile;
+    int blockSize = 512;
+    juce::Array<juce::File> inputFiles;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const juce::String arg (argv[i]);
+
+        if (arg == "--cues" && i + 1 < argc)
+            cueFile = juce::File::getCurrentWorkingDirectory().getChildFile (argv[++i]);
+        else if (arg == "--output" && i + 1 < argc)
+            outputFile = juce::File::getCurrentWorkingDirectory().getChildFile (argv[++i]);
+        else if (arg == "--trace" && i + 1 < argc)
+            traceFile = juce::File::getCurrentWorkingDirectory().getChildFile (argv[++i]);
+        else if (arg == "--block" && i + 1 < argc)
+            blockSize = juce::jlimit (16, 65536, juce::String (argv[++i]).getIntValue());
+        else
+            inputFiles.add (juce::File::getCurrentWorkingDirectory().getChildFile (arg));
+    }
+
+    if (! cueFile.existsAsFile() || outputFile == juce::File() || inputFiles.size() < 2)
+    {
+        std::cerr << "Usage: ABComparisonRenderer --cues <cues.json|cues.csv> --output <out.wav> [--block <size>] [--trace <trace.json>] <input1> <input2> ..." << std::endl;
+        return 1;
+    }
+
+    if (inputFiles.size() > AbcomparisonAudioProcessor::maxNChoices)
+    {
+        std::cerr << "At most " << AbcomparisonAudioProcessor::maxNChoices << " inputs are supported." << std::endl;
+        return 1;
+    }
+
+    // open the inputs, every input is one choice
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+
+    std::vector<std::unique_ptr<juce::AudioFormatReader>> readers;
+    int stride = 1;
+    juce::int64 length = 0;
+
+    for (auto& file : inputFiles)
+    {
+        auto reader = openInput (formatManager, file);
+        if (reader == nullptr)
+        {
+            std::cerr << "Couldn't open " << file.getFullPathName() << std::endl;
+            return 1;
+        }
+
+        // the inputs aren't resampled, they all have to be at the rate of the first one
+        if (! readers.empty() && reader->sampleRate != readers.front()->sampleRate)
+        {
+            std::cerr << file.getFullPathName() << " has a sample rate of " << reader->sampleRate << " Hz, the first input has "
+                      << readers.front()->sampleRate << " Hz." << std::endl;
+            return 1;
+        }
+
+        stride = juce::jmax (stride, static_cast<int> (reader->numChannels));
+        length = juce::jmax (length, reader->lengthInSamples);
+        readers.push_back (std::move (reader));
+    }
+
+    const double sampleRate = readers.front()->sampleRate;
+    const int nChoices = static_cast<int> (readers.size());
+    stride = juce::jmin (stride, AbcomparisonAudioProcessor::maxChannelSize);
+
+    AbcomparisonAudioProcessor processor;
+    const int nChannels = juce::jmax (processor.getTotalNumInputChannels(), processor.getTotalNumOutputChannels());
+
+    if (nChoices * stride > processor.getMainBusNumInputChannels())
+    {
+        std::cerr << nChoices << " inputs with " << stride << " channels don't fit into the "
+                  << processor.getMainBusNumInputChannels() << " input channels of the processor." << std::endl;
+        return 1;
+    }
+
+    setParameter (processor, "numberOfChoices", nChoices - 2.0f);
+    setParameter (processor, "channelSize", stride - 1.0f);
+
+    const auto cues = parseCueList (cueFile);
+
+    // the processor starts with the settings of the cues at time zero
+    int cueIndex = 0;
+    for (; cueIndex < cues.size() && cues[cueIndex].time <= 0.0; ++cueIndex)
+        applyCue (processor, cues[cueIndex]);
+
+    processor.setRateAndBufferSizeDetails (sampleRate, blockSize);
+    processor.prepareToPlay (sampleRate, blockSize);
+
+    // output
+    outputFile.deleteFile();
+    std::unique_ptr<juce::OutputStream> outputStream (outputFile.createOutputStream());
+    std::unique_ptr<juce::AudioFormatWriter> writer;
+    if (outputStream != nullptr)
+        writer.reset (juce::WavAudioFormat().createWriterFor (outputStream.get(), sampleRate, static_cast<unsigned int> (stride), 24, {}, 0));
+
+    if (writer == nullptr)
+    {
+        std::cerr << "Couldn't create " << outputFile.getFullPathName() << std::endl;
+        return 1;
+    }
+
+    outputStream.release(); // the writer owns the stream now
+
+   #if ABCOMPARISON_TRACING
+    EventTracer::getInstance().setEnabled (traceFile != juce::File());
+   #else
+    if (traceFile != juce::File())
+        std::cerr << "The tracer isn't compiled in, build with ABCOMPARISON_ENABLE_TRACING to use --trace." << std::endl;
+   #endif
+
+    // render, the blocks are split at the cues, so every cue hits its exact sample; in 64 bit, as long renderings exceed an int
+    const auto getCueSample = [&cues, sampleRate] (int index) { return static_cast<juce::int64> (std::llround (cues[index].time * sampleRate)); };
+
+    juce::AudioBuffer<float> buffer (nChannels, blockSize);
+    juce::MidiBuffer midi;
+    const auto startTime = juce::Time::getMillisecondCounterHiRes();
+
+    for (juce::int64 position = 0; position < length;)
+    {
+        for (; cueIndex < cues.size() && getCueSample (cueIndex) <= position; ++cueIndex)
+            applyCue (processor, cues[cueIndex]);
+
+        auto blockEnd = juce::jmin (length, position + blockSize);
+        if (cueIndex < cues.size())
+            blockEnd = juce::jmin (blockEnd, getCueSample (cueIndex));
+
+        const int numSamples = static_cast<int> (blockEnd - position);
+        juce::AudioBuffer<float> block (buffer.getArrayOfWritePointers(), nChannels, numSamples);
+        block.clear();
+
+        for (int choice = 0; choice < nChoices; ++choice)
+        {
+            auto& reader = *readers[static_cast<size_t> (choice)];
+            reader.read (block.getArrayOfWritePointers() + choice * stride, juce::jmin (stride, static_cast<int> (reader.numChannels)),
+                         position, numSamples);
+        }
+
+        processor.processBlock (block, midi);
+        writer->writeFromAudioSampleBuffer (block, 0, numSamples);
+
+        position = blockEnd;
+    }
+
+    processor.releaseResources();
+    writer.reset();
+
+   #if ABCOMPARISON_TRACING
+    if (traceFile != juce::File() && ! EventTracer::getInstance().writeChromeTrace (traceFile))
+        std::cerr << "Couldn't write " << traceFile.getFullPathName() << std::endl;
+   #endif
+
+    const auto seconds = (juce::Time::getMillisecondCounterHiRes() - startTime) / 1000.0;
+    std::cout << "Rendered " << length / sampleRate << "s in " << seconds << "s to " << outputFile.getFullPathName() << std::endl;
+
+   #if ABCOMPARISON_REALTIME_CHECKS
+    if (const int violations = RealtimeChecker::getNumViolations())
+    {
+        std::cerr << violations << " real-time violations while rendering." << std::endl;
+        return 1;
+    }
+   #endif
+
+    return 0;
+}
@@ -0,0 +1,127 @@
+/*
+==============================================================================
+
+ABComparison Plug-in
+Copyright (C) 2018 - Daniel Rudrich
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+==============================================================================
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+/** Hands the output and a reference choice from the audio thread to the analyzer.
+
+    While the analyzer is running, the audio thread copies the first channel of both into a
+    lock-free FIFO, that's all it does. If the FIFO is full, the block is dropped.
+    There's one writer (the audio thread) and one reader (the analyzer's thread).
+*/
+class AnalyzerTap
+{
+public:
+    static constexpr int fifoSize = 1 << 15;
+    enum Channel { output, reference };
+
+    AnalyzerTap()
+    {
+        fifoBuffer.clear();
+    }
+
+    //==============================================================================
+    /** Message thread: the audio thread only writes while the analyzer is running. */
+    void setActive (bool shouldBeActive) noexcept { active = shouldBeActive; }
+    void setReferenceChoice (int choice) noexcept { referenceChoice = choice; }
+    int getReferenceChoice() const noexcept { return referenceChoice.load(); }
+    double getSampleRate() const noexcept { return sampleRate.load(); }
+
+    //==============================================================================
+    /** Audio thread: beginBlock() reserves space for the block, write() fills it, endBlock() publishes it. */
+    void prepare (double newSampleRate) noexcept { sampleRate = newSampleRate; }
+
+    void beginBlock (int numSamples) noexcept
+    {
+        writing = active.load() && numSamples <= fifo.getFreeSpace();
+        if (writing)
+            fifo.prepareToWrite (numSamples, start1, size1, start2, size2);
+    }
+
+    /** A nullptr writes silence. */
+    void write (Channel channel, const float* samples) noexcept
+    {
+        if (! writing)
+            return;
+
+        float* dest = fifoBuffer.getWritePointer (channel);
+        if (samples == nullptr)
+        {
+            juce::FloatVectorOperations::clear (dest + start1, size1);
+            juce::FloatVectorOperations::clear (dest + start2, size2);
+        }
+        else
+        {
+            juce::FloatVectorOperations::copy (dest + start1, samples, size1);
+            juce::FloatVectorOperations::copy (dest + start2, samples + size1, size2);
+        }
+    }
+
+    void endBlock() noexcept
+    {
+        if (writing)
+            fifo.finishedWrite (size1 + size2);
+
+        writing = false;
+    }
+
+    //==============================================================================
+    /** Analyzer thread. */
+    int getNumReady() const noexcept { return fifo.getNumReady(); }
+
+    void read (float* outputSamples, float* referenceSamples, int numSamples) noexcept
+    {
+        int readStart1, readSize1, readStart2, readSize2;
+        fifo.prepareToRead (numSamples, readStart1, readSize1, readStart2, readSize2);
+
+        float* const dest[] = { outputSamples, referenceSamples };
+        for (int channel = 0; channel < 2; ++channel)
+        {
+            const float* source = fifoBuffer.getReadPointer (channel);
+            juce::FloatVectorOperations::copy (dest[channel], source + readStart1, readSize1);
+            juce::FloatVectorOperations::copy (dest[channel] + readSize1, source + readStart2, readSize2);
+        }
+
+        fifo.finishedRead (readSize1 + readSize2);
+    }
+
+    void discard() noexcept
+    {
+        fifo.finishedRead (fifo.getNumReady());
+    }
+
+private:
+    juce::AudioBuffer<float> fifoBuffer { 2, fifoSize };
+    juce::AbstractFifo fifo { fifoSize };
+
+    std::atomic<bool> active { false };
+    std::atomic<int> referenceChoice { 1 };
+    std::atomic<double> sampleRate { 48000.0 };
+
+    // audio thread
+    bool writing = false;
+    int start1 = 0, size1 = 0, start2 = 0, size2 = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AnalyzerTap)
+};
@@ -0,0 +1,186 @@
+/*
+==============================================================================
+
+ABComparison Plug-in
+Copyright (C) 2018 - Daniel Rudrich
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+==============================================================================
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+/*
+ ===== Event tracing =====
+ Compiled in with ABCOMPARISON_TRACING=1 (CMake option ABCOMPARISON_ENABLE_TRACING), and
+ recording only while enabled at runtime. Otherwise, the macros below compile to nothing.
+
+    ABC_TRACE_THREAD ("audio");                  names the calling thread in the trace
+    ABC_TRACE_SCOPE ("processBlock");            duration event, from here to the end of the scope
+    ABC_TRACE_INSTANT ("dequeue", "choice", 3);  instant event with one integer argument
+ */
+#ifndef ABCOMPARISON_TRACING
+ #define ABCOMPARISON_TRACING 0
+#endif
+
+#if ABCOMPARISON_TRACING
+
+/** Records timestamped events into one lock-free ring buffer per thread, and writes them as
+    Chrome trace JSON, which can be opened with Perfetto (ui.perfetto.dev) or chrome://tracing.
+
+    The ring buffers are preallocated, a thread claims one with its first event, so recording
+    never allocates or locks. Each buffer keeps the most recent events of its thread.
+    Names have to be string literals, only their pointers are stored.
+*/
+class EventTracer
+{
+public:
+    static constexpr int maxThreads = 16;
+    static constexpr int eventsPerThread = 1 << 13;
+
+    static EventTracer& getInstance()
+    {
+        static EventTracer instance;
+        return instance;
+    }
+
+    void setEnabled (bool shouldBeEnabled) noexcept { enabled.store (shouldBeEnabled, std::memory_order_relaxed); }
+    bool isEnabled() const noexcept { return enabled.load (std::memory_order_relaxed); }
+
+    void setThreadName (const char* name) noexcept
+    {
+        if (! isEnabled())
+            return;
+
+        if (auto* buffer = getThreadBuffer())
+            buffer->name.store (name, std::memory_order_relaxed);
+    }
+
+    void record (char phase, const char* name, const char* argName = nullptr, juce::int64 arg = 0) noexcept
+    {
+        if (! isEnabled())
+            return;
+
+        if (auto* buffer = getThreadBuffer())
+        {
+            // single writer per buffer: fill the slot, then publish it
+            const auto count = buffer->count.load (std::memory_order_relaxed);
+            buffer->events[count % eventsPerThread] = { juce::Time::getHighResolutionTicks(), name, argName, arg, phase };
+            buffer->count.store (count + 1, std::memory_order_release);
+        }
+    }
+
+    /** Writes the recorded events of all threads. Events recorded while writing might be torn, so
+        preferably dump while the activity of interest is over. */
+    bool writeChromeTrace (const juce::File& file) const
+    {
+        juce::FileOutputStream out (file);
+        if (! out.openedOk())
+            return false;
+
+        out.setPosition (0);
+        out.truncate();
+
+        const double ticksPerMicrosecond = juce::Time::getHighResolutionTicksPerSecond() / 1.0e6;
+        const auto pid = 1;
+        bool first = true;
+
+        auto separator = [&] () -> juce::String { auto s = first ? "\n" : ",\n"; first = false; return s; };
+
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+        for (int tid = 0; tid < juce::jmin (maxThreads, numThreads.load()); ++tid)
+        {
+            const auto& buffer = buffers[tid];
+
+            if (auto* name = buffer.name.load (std::memory_order_relaxed))
+                out << separator() << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << pid << ",\"tid\":" << tid
+                    << ",\"args\":{\"name\":" << juce::JSON::toString (juce::String (name)) << "}}";
+
+            const auto count = buffer.count.load (std::memory_order_acquire);
+            for (auto i = count > eventsPerThread ? count - eventsPerThread : 0; i < count; ++i)
+            {
+                const auto& event = buffer.events[i % eventsPerThread];
+
+                out << separator() << "{\"ph\":\"" << juce::String::charToString (event.phase) << "\",\"name\":"
+                    << juce::JSON::toString (juce::String (event.name)) << ",\"pid\":" << pid << ",\"tid\":" << tid
+                    << ",\"ts\":" << juce::String (event.ticks / ticksPerMicrosecond, 3);
+
+                if (event.phase == 'i')
+                    out << ",\"s\":\"t\"";
+
+                if (event.argName != nullptr)
+                    out << ",\"args\":{" << juce::JSON::toString (juce::String (event.argName)) << ":" << juce::String (event.arg) << "}";
+
+                out << "}";
+            }
+        }
+
+        out << "\n]}\n";
+        return true;
+    }
+
+    /** Records a duration event for the lifetime of this object. */
+    struct ScopedEvent
+    {
+        explicit ScopedEvent (const char* eventName) noexcept : name (eventName) { getInstance().record ('B', name); }
+        ~ScopedEvent() { getInstance().record ('E', name); }
+
+        const char* name;
+    };
+
+private:
+    EventTracer() = default;
+
+    struct Event
+    {
+        juce::int64 ticks;
+        const char* name;
+        const char* argName;
+        juce::int64 arg;
+        char phase;
+    };
+
+    struct ThreadBuffer
+    {
+        std::atomic<const char*> name { nullptr };
+        std::atomic<juce::int64> count { 0 };
+        Event events[eventsPerThread];
+    };
+
+    ThreadBuffer* getThreadBuffer() noexcept
+    {
+        // claimed once per thread, threads beyond maxThreads aren't traced
+        thread_local const int tid = numThreads.fetch_add (1);
+        return tid < maxThreads ? &buffers[tid] : nullptr;
+    }
+
+    std::atomic<bool> enabled { false };
+    std::atomic<int> numThreads { 0 };
+    ThreadBuffer buffers[maxThreads];
+
+    JUCE_DECLARE_NON_COPYABLE (EventTracer)
+};
+
+ #define ABC_TRACE_THREAD(name)                  EventTracer::getInstance().setThreadName (name)
+ #define ABC_TRACE_SCOPE(name)                   const EventTracer::ScopedEvent JUCE_JOIN_MACRO (traceEvent_, __LINE__) (name)
+ #define ABC_TRACE_INSTANT(name, argName, arg)   EventTracer::getInstance().record ('i', name, argName, static_cast<juce::int64> (arg))
+#else
+ #define ABC_TRACE_THREAD(name)
+ #define ABC_TRACE_SCOPE(name)
+ #define ABC_TRACE_INSTANT(name, argName, arg)
+#endif
@@ -25,7 +25,7 @@
 
 //==============================================================================
 AbcomparisonAudioProcessorEditor::AbcomparisonAudioProcessorEditor (AbcomparisonAudioProcessor& p, juce::AudioProcessorValueTreeState& vts)
-: AudioProcessorEditor (&p), processor (p), parameters (vts)
+: AudioProcessorEditor (&p), processor (p), parameters (vts), analyzer (p.getAnalyzerTap())
 {
     toolTipWin.setMillisecondsBeforeTipAppears (200);
     toolTipWin.setOpaque (false);
@@ -55,7 +55,7 @@ AbcomparisonAudioProcessorEditor::AbcomparisonAudioProcessorEditor (Abcomparison
     addAndMakeVisible (cbChannelSize);
     cbChannelSize.setJustificationType (juce::Justification::centred);
 
-    for (int i = 1; i <= 32; ++i)
+    for (int i = 1; i <= processor.maxChannelSize; ++i)
         cbChannelSize.addItem (juce::String (i) + " ch", i);
 
     cbChannelSizeAttachment.reset (new ComboBoxAttachment (parameters, "channelSize", cbChannelSize));
@@ -67,21 +67,35 @@ AbcomparisonAudioProcessorEditor::AbcomparisonAudioProcessorEditor (Abcomparison
     slFadeTime.setTextBoxStyle (juce::Slider::TextBoxBelow, false, 80, 20);
     slFadeTime.setTextValueSuffix (" ms");
 
+    addAndMakeVisible (tbZeroCrossing);
+    tbZeroCrossingAttachment.reset (new ButtonAttachment (parameters, "zeroCrossingSwitch", tbZeroCrossing));
+    tbZeroCrossing.setButtonText ("");
+    tbZeroCrossing.setTooltip ("Zero-crossing switch: instead of fading, switches at the quietest point within the next 10ms with a micro-fade of a few samples");
+
+    addAndMakeVisible (cbQuantization);
+    cbQuantization.addItemList ({ "Off", "Beat", "Bar", "Grid" }, 1);
+    cbQuantization.setTooltip ("Defers switches until the next beat, bar or grid line of the host's transport. The grid length can be set in the labels dialog");
+    cbQuantizationAttachment.reset (new ComboBoxAttachment (parameters, "quantization", cbQuantization));
+
     addAndMakeVisible (tbEditLabels);
     tbEditLabels.setButtonText ("Labels");
     tbEditLabels.onClick = [this] () { editLabels(); };
 
+    addAndMakeVisible (tbEditFiles);
+    tbEditFiles.setButtonText ("Files");
+    tbEditFiles.setTooltip ("Lets choices play audio files in sync with the host's transport, instead of their input channels");
+    tbEditFiles.onClick = [this] () { editFiles(); };
+
+    addAndMakeVisible (tbSnapshots);
+    tbSnapshots.setButtonText ("Snapshots");
+    tbSnapshots.setTooltip ("Stores and recalls the switching state. Snapshots can also be recalled with MIDI program changes, '/snapshot i' via OSC or the 'Snapshot' parameter");
+    tbSnapshots.onClick = [this] () { editSnapshots(); };
+
     addAndMakeVisible (tbEnableOSC);
     tbEnableOSC.setButtonText ("");
     tbEnableOSC.setTooltip ("Enables/disables OSC");
-    tbEnableOSC.setToggleState (p.getOSCReceiver().getAutoConnect(), juce::dontSendNotification);
-    tbEnableOSC.onClick = [&] ()
-    {
-        const auto enable = tbEnableOSC.getToggleState();
-        p.getOSCReceiver().setAutoConnect (enable);
-        if (! enable)
-            p.getOSCReceiver().disconnect();
-    };
+    tbEnableOSC.setToggleState (p.isOSCEnabled(), juce::dontSendNotification);
+    tbEnableOSC.onClick = [&] () { p.setOSCEnabled (tbEnableOSC.getToggleState()); };
 
     addAndMakeVisible (teOSCPort);
     teOSCPort.setMultiLine (false);
@@ -89,7 +103,8 @@ AbcomparisonAudioProcessorEditor::AbcomparisonAudioProcessorEditor (Abcomparison
     teOSCPort.setReadOnly (false);
     teOSCPort.setScrollbarsShown (true);
     teOSCPort.setJustification (juce::Justification::centred);
-    teOSCPort.setTooltip ("The OSC port for receiving switch command. The command should be '/switch i', with i being the choice you want to play.");
+    teOSCPort.setTooltip ("The OSC port for receiving switch commands. It is shared by all instances, changing it here changes it for all of them. The command should be '/switch i', with i being the choice you want to play. "
+                          "A single instance can be addressed with '/abc/" + juce::String (p.getOSCId()) + "/switch i' or by its name, which can be set in the labels dialog.");
     teOSCPort.setText (juce::String (p.getOSCReceiver().getPortNumber()), juce::dontSendNotification);
     teOSCPort.onReturnKey = [&] ()
     {
@@ -97,6 +112,33 @@ AbcomparisonAudioProcessorEditor::AbcomparisonAudioProcessorEditor (Abcomparison
         p.getOSCReceiver().setPort (currentPort);
     };
 
+    addAndMakeVisible (lbCycleStatus);
+    lbCycleStatus.setJustificationType (juce::Justification::centredLeft);
+
+    // the analyzer only runs while it's shown, and stops with the editor
+    addChildComponent (analyzer);
+
+    addAndMakeVisible (tbAnalyzer);
+    tbAnalyzer.setButtonText ("Analyzer");
+    tbAnalyzer.setTooltip ("Shows the spectra of the output and a reference choice, or their difference");
+    tbAnalyzer.onClick = [this] () { showAnalyzer (tbAnalyzer.getToggleState()); };
+
+    addChildComponent (cbAnalyzerMode);
+    cbAnalyzerMode.addItemList ({ "Spectra", "Difference" }, 1);
+    cbAnalyzerMode.setSelectedId (1, juce::dontSendNotification);
+    cbAnalyzerMode.onChange = [this] ()
+    {
+        analyzer.setMode (cbAnalyzerMode.getSelectedId() == 2 ? SpectrumAnalyzer::difference : SpectrumAnalyzer::spectra);
+    };
+
+    addChildComponent (cbAnalyzerReference);
+    cbAnalyzerReference.setTooltip ("The reference choice, shown in orange");
+    for (int choice = 0; choice < processor.maxNChoices; ++choice)
+        cbAnalyzerReference.addItem ("Ref. " + juce::String (choice + 1), choice + 1);
+
+    cbAnalyzerReference.setSelectedId (processor.getAnalyzerTap().getReferenceChoice() + 1, juce::dontSendNotification);
+    cbAnalyzerReference.onChange = [this] () { processor.getAnalyzerTap().setReferenceChoice (cbAnalyzerReference.getSelectedId() - 1); };
+
     flexBox.flexWrap = juce::FlexBox::Wrap::wrap;
     flexBox.alignContent = juce::FlexBox::AlignContent::flexStart;
 
@@ -105,12 +147,15 @@ AbcomparisonAudioProcessorEditor::AbcomparisonAudioProcessorEditor (Abcomparison
         auto handle = tbChoice.add (new juce::TextButton);
         addAndMakeVisible (handle);
 
-        tbChoiceAttachments.add (new ButtonAttachment (parameters, "choiceState" + juce::String (choice), *handle));
-        handle->setClickingTogglesState (true);
+        // in exclusive solo, a click only sets the selectedChoice parameter, so the buttons follow the processor
+        handle->onClick = [this, choice] { processor.switchChoice (choice); };
         handle->setColour (juce::TextButton::buttonOnColourId, cols[choice % cols.size()]);
     }
 
     updateNumberOfButtons();
+    updateChoiceButtons();
+
+    std::fill (std::begin (choiceShowsSignal), std::end (choiceShowsSignal), true);
 
 
     // set the size of the GUI so the number of choices (nChoices) will fit in there
@@ -134,6 +179,8 @@ AbcomparisonAudioProcessorEditor::~AbcomparisonAudioProcessorEditor()
 //==============================================================================
 void AbcomparisonAudioProcessorEditor::paint (juce::Graphics& g)
 {
+    ABC_TRACE_SCOPE ("editorPaint");
+
     // (Our component is opaque, so we must completely fill the background with a solid colour)
     g.fillAll (getLookAndFeel().findColour (juce::ResizableWindow::backgroundColourId));
 
@@ -170,7 +217,11 @@ void AbcomparisonAudioProcessorEditor::paint (juce::Graphics& g)
     g.drawText ("Switch mode", headlineRow.removeFromLeft (110), juce::Justification::centred, 1);
     headlineRow.removeFromLeft (7);
     g.drawText ("FadeTime", headlineRow.removeFromLeft (120), juce::Justification::centred, 1);
-    headlineRow.removeFromLeft (7 + 75 + 10);
+    headlineRow.removeFromLeft (7);
+    g.drawText ("ZC", headlineRow.removeFromLeft (26), juce::Justification::left, 1);
+    headlineRow.removeFromLeft (7);
+    g.drawText ("Quantize", headlineRow.removeFromLeft (75), juce::Justification::centred, 1);
+    headlineRow.removeFromLeft (7 + 75 + 7 + 60 + 7 + 75 + 10);
     g.drawText ("OSC", headlineRow.removeFromLeft (26), juce::Justification::left, 1);
     g.drawText ("Port", headlineRow.removeFromLeft (70), juce::Justification::centred, 1);
 }
@@ -191,13 +242,36 @@ void AbcomparisonAudioProcessorEditor::resized()
     settingsArea.removeFromLeft (7);
     slFadeTime.setBounds (settingsArea.removeFromLeft (110).withHeight (45));
     settingsArea.removeFromLeft (7);
+    tbZeroCrossing.setBounds (settingsArea.removeFromLeft (26));
+    settingsArea.removeFromLeft (7);
+    cbQuantization.setBounds (settingsArea.removeFromLeft (75));
+    settingsArea.removeFromLeft (7);
     tbEditLabels.setBounds (settingsArea.removeFromLeft (75));
+    settingsArea.removeFromLeft (7);
+    tbEditFiles.setBounds (settingsArea.removeFromLeft (60));
+    settingsArea.removeFromLeft (7);
+    tbSnapshots.setBounds (settingsArea.removeFromLeft (75));
     settingsArea.removeFromLeft (10);
     tbEnableOSC.setBounds (settingsArea.removeFromLeft (26));
     teOSCPort.setBounds (settingsArea.removeFromLeft (70));
 
     bounds.removeFromTop (30);
 
+    auto statusRow = bounds.removeFromBottom (20);
+    tbAnalyzer.setBounds (statusRow.removeFromRight (80));
+    if (analyzer.isVisible())
+    {
+        cbAnalyzerReference.setBounds (statusRow.removeFromRight (80));
+        statusRow.removeFromRight (4);
+        cbAnalyzerMode.setBounds (statusRow.removeFromRight (100));
+        statusRow.removeFromRight (10);
+
+        analyzer.setBounds (bounds.removeFromBottom (juce::jmin (180, bounds.getHeight() / 2)));
+        bounds.removeFromBottom (5);
+    }
+
+    lbCycleStatus.setBounds (statusRow);
+
     flexBoxArea = bounds;
     flexBox.performLayout (bounds);
 
@@ -237,6 +311,8 @@ void AbcomparisonAudioProcessorEditor::updateNumberOfButtons()
 
 void AbcomparisonAudioProcessorEditor::timerCallback()
 {
+    ABC_TRACE_SCOPE ("editorTimer");
+
     if (cbNChoices.getSelectedId() + 1 != nChoices)
         updateNumberOfButtons();
 
@@ -257,11 +333,73 @@ void AbcomparisonAudioProcessorEditor::timerCallback()
 
     if (processor.updateButtonSize.exchange (false))
         updateButtonSize();
+
+    updateChoiceButtons();
+    updateSignalIndicators();
+    updateCycleStatus();
+}
+
+void AbcomparisonAudioProcessorEditor::updateChoiceButtons()
+{
+    for (int choice = 0; choice < nChoices; ++choice)
+        tbChoice.getUnchecked (choice)->setToggleState (processor.isChoiceOn (choice), juce::dontSendNotification);
+}
+
+void AbcomparisonAudioProcessorEditor::updateCycleStatus()
+{
+    juce::String status;
+
+    const int choice = processor.getCycleChoice();
+    if (juce::isPositiveAndBelow (choice, nChoices))
+    {
+        const float remaining = processor.getCycleRemaining();
+        status << "Auto-cycle: " << tbChoice[choice]->getButtonText() << ", next step in ";
+        if (*parameters.getRawParameterValue ("cycleUnit") >= 0.5f)
+            status << juce::roundToInt (remaining) << (juce::roundToInt (remaining) == 1 ? " bar" : " bars");
+        else
+            status << juce::String (remaining, 1) << " s";
+    }
+
+    if (status != lbCycleStatus.getText())
+        lbCycleStatus.setText (status, juce::dontSendNotification);
+}
+
+void AbcomparisonAudioProcessorEditor::showAnalyzer (bool shouldBeShown)
+{
+    analyzer.setVisible (shouldBeShown);
+    cbAnalyzerMode.setVisible (shouldBeShown);
+    cbAnalyzerReference.setVisible (shouldBeShown);
+
+    if (shouldBeShown)
+        analyzer.start();
+    else
+        analyzer.stop();
+
+    resized();
+}
+
+void AbcomparisonAudioProcessorEditor::updateSignalIndicators()
+{
+    // choices without input signal get dimmed labels
+    for (int choice = 0; choice < nChoices; ++choice)
+    {
+        const bool hasSignal = processor.choiceHasSignal (choice);
+        if (hasSignal == choiceShowsSignal[choice])
+            continue;
+
+        choiceShowsSignal[choice] = hasSignal;
+
+        auto* button = tbChoice.getUnchecked (choice);
+        const float alpha = hasSignal ? 1.0f : 0.35f;
+        button->setColour (juce::TextButton::textColourOffId, getLookAndFeel().findColour (juce::TextButton::textColourOffId).withMultipliedAlpha (alpha));
+        button->setColour (juce::TextButton::textColourOnId, getLookAndFeel().findColour (juce::TextButton::textColourOnId).withMultipliedAlpha (alpha));
+        button->setTooltip (hasSignal ? juce::String() : "no signal");
+    }
 }
 
 void AbcomparisonAudioProcessorEditor::changeListenerCallback (juce::ChangeBroadcaster *source)
 {
-    if (processor.getOSCReceiver().getAutoConnect())
+    if (processor.isOSCEnabled())
     {
         if (processor.getOSCReceiver().isConnected())
             teOSCPort.setColour (juce::TextEditor::outlineColourId, juce::Colours::green);
@@ -271,18 +409,78 @@ void AbcomparisonAudioProcessorEditor::changeListenerCallback (juce::ChangeBroad
     else
         teOSCPort.setColour (juce::TextEditor::outlineColourId, getLookAndFeel().findColour (juce::TextEditor::outlineColourId));
 
+    // the port is shared by all instances, so another instance might have changed it
+    if (! teOSCPort.hasKeyboardFocus (false))
+        teOSCPort.setText (juce::String (processor.getOSCReceiver().getPortNumber()), juce::dontSendNotification);
+
     teOSCPort.repaint();
 }
 
 
 void AbcomparisonAudioProcessorEditor::editLabels()
 {
-    auto settings = std::make_unique<SettingsComponent> (processor);
-    settings->setSize (300, 250);
+    auto settings = std::make_unique<SettingsComponent> (processor, parameters);
+    settings->setSize (320, 635);
 
     juce::CallOutBox::launchAsynchronously (std::move (settings), tbEditLabels.getScreenBounds(), nullptr);
 }
 
+void AbcomparisonAudioProcessorEditor::editFiles()
+{
+    juce::PopupMenu menu;
+
+    for (int choice = 0; choice < nChoices; ++choice)
+    {
+        const auto file = processor.getFile (choice);
+        const bool hasFile = file != juce::File();
+
+        juce::PopupMenu choiceMenu;
+        choiceMenu.addItem ("Load audio file...", [this, choice] () { chooseFile (choice); });
+        choiceMenu.addItem ("Use input channels", hasFile, ! hasFile, [this, choice] () { processor.unloadFile (choice); });
+
+        menu.addSubMenu (tbChoice[choice]->getButtonText() + ": " + (hasFile ? file.getFileName() : "input channels"), choiceMenu);
+    }
+
+    menu.showMenuAsync (juce::PopupMenu::Options().withTargetComponent (&tbEditFiles));
+}
+
+void AbcomparisonAudioProcessorEditor::chooseFile (const int choice)
+{
+    fileChooser = std::make_unique<juce::FileChooser> ("Select an audio file for " + tbChoice[choice]->getButtonText(),
+                                                       processor.getFile (choice), processor.getAudioFileWildcard());
+
+    fileChooser->launchAsync (juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles,
+                              [this, choice] (const juce::FileChooser& chooser)
+                              {
+                                  const auto file = chooser.getResult();
+                                  if (file.existsAsFile() && ! processor.loadFile (choice, file))
+                                      juce::AlertWindow::showMessageBoxAsync (juce::AlertWindow::WarningIcon, "ABComparison",
+                                                                              "Couldn't open " + file.getFileName() + ". Audio files have to be at the session's sample rate ("
+                                                                              + juce::String (juce::roundToInt (processor.getSampleRate())) + " Hz).");
+                              });
+}
+
+void AbcomparisonAudioProcessorEditor::editSnapshots()
+{
+    juce::PopupMenu menu, storeMenu, clearMenu;
+
+    for (int index = 0; index < processor.numSnapshots; ++index)
+    {
+        const bool isStored = processor.isSnapshotStored (index);
+        const auto name = "Snapshot " + juce::String (index + 1);
+
+        menu.addItem ("Recall " + name, isStored, false, [this, index] () { processor.recallSnapshot (index); });
+        storeMenu.addItem (name, true, isStored, [this, index] () { processor.storeSnapshot (index); });
+        clearMenu.addItem (name, isStored, false, [this, index] () { processor.clearSnapshot (index); });
+    }
+
+    menu.addSeparator();
+    menu.addSubMenu ("Store current state", storeMenu);
+    menu.addSubMenu ("Clear", clearMenu);
+
+    menu.showMenuAsync (juce::PopupMenu::Options().withTargetComponent (&tbSnapshots));
+}
+
 void AbcomparisonAudioProcessorEditor::updateLabelText()
 {
     auto labels = juce::StringArray::fromLines (processor.getLabelText());
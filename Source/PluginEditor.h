@@ -25,6 +25,7 @@
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "PluginProcessor.h"
 #include "SettingsComponent.h"
+#include "SpectrumAnalyzer.h"
 
 typedef juce::AudioProcessorValueTreeState::SliderAttachment SliderAttachment;
 typedef juce::AudioProcessorValueTreeState::ComboBoxAttachment ComboBoxAttachment;
@@ -51,8 +52,15 @@ public:
     void timerCallback() override;
 
     void editLabels();
+    void editFiles();
+    void chooseFile (const int choice);
+    void editSnapshots();
     void updateLabelText();
     void updateButtonSize();
+    void updateChoiceButtons();
+    void updateSignalIndicators();
+    void updateCycleStatus();
+    void showAnalyzer (bool shouldBeShown);
 
     void changeListenerCallback (juce::ChangeBroadcaster *source) override;
 
@@ -66,18 +74,29 @@ private:
     juce::ComboBox cbChannelSize;
     juce::ComboBox cbNChoices;
     juce::Slider slFadeTime;
+    juce::ToggleButton tbZeroCrossing;
+    juce::ComboBox cbQuantization;
     juce::ToggleButton tbEnableOSC;
     juce::TextEditor teOSCPort;
+    juce::Label lbCycleStatus;
+
+    SpectrumAnalyzer analyzer;
+    juce::ToggleButton tbAnalyzer;
+    juce::ComboBox cbAnalyzerMode, cbAnalyzerReference;
 
     int nChoices = 2;
+    bool choiceShowsSignal[AbcomparisonAudioProcessor::maxNChoices];
 
-    std::unique_ptr<ComboBoxAttachment> cbSwitchModeAttachment, cbChannelSizeAttachment, cbNChoicesAttachment;
+    std::unique_ptr<ComboBoxAttachment> cbSwitchModeAttachment, cbChannelSizeAttachment, cbNChoicesAttachment, cbQuantizationAttachment;
     std::unique_ptr<SliderAttachment> slFadeTimeAttachment;
+    std::unique_ptr<ButtonAttachment> tbZeroCrossingAttachment;
 
     juce::OwnedArray<juce::TextButton> tbChoice;
-    juce::OwnedArray<ButtonAttachment> tbChoiceAttachments;
 
     juce::TextButton tbEditLabels;
+    juce::TextButton tbEditFiles;
+    juce::TextButton tbSnapshots;
+    std::unique_ptr<juce::FileChooser> fileChooser;
 
     juce::FlexBox flexBox;
     juce::Rectangle<int> flexBoxArea;
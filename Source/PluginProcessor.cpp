@@ -25,45 +25,103 @@
 
 const juce::Identifier AbcomparisonAudioProcessor::OSCPort = "OSCPort";
 const juce::Identifier AbcomparisonAudioProcessor::OSCEnabled = "OSCEnabled";
+const juce::Identifier AbcomparisonAudioProcessor::OSCName = "OSCName";
 const juce::Identifier AbcomparisonAudioProcessor::EditorWidth = "editorWidth";
 const juce::Identifier AbcomparisonAudioProcessor::EditorHeight = "editorHeight";
 const juce::Identifier AbcomparisonAudioProcessor::LabelText = "labelText";
 const juce::Identifier AbcomparisonAudioProcessor::ButtonSize = "buttonSize";
+const juce::Identifier AbcomparisonAudioProcessor::AudioFiles = "AudioFiles";
+const juce::Identifier AbcomparisonAudioProcessor::AudioFile = "AudioFile";
+const juce::Identifier AbcomparisonAudioProcessor::ChoiceIndex = "choice";
+const juce::Identifier AbcomparisonAudioProcessor::FilePath = "path";
+const juce::Identifier AbcomparisonAudioProcessor::FoldDownUserMatrix = "foldDownMatrix";
+const juce::Identifier AbcomparisonAudioProcessor::Snapshots = "Snapshots";
+const juce::Identifier AbcomparisonAudioProcessor::SnapshotState = "Snapshot";
+const juce::Identifier AbcomparisonAudioProcessor::SnapshotIndex = "index";
+const juce::Identifier AbcomparisonAudioProcessor::SnapshotChoices = "choices";
+const juce::Identifier AbcomparisonAudioProcessor::SnapshotFadeTime = "fadeTime";
+const juce::Identifier AbcomparisonAudioProcessor::SnapshotToggleMode = "toggleMode";
+const juce::Identifier AbcomparisonAudioProcessor::SnapshotTrims = "trims";
+const juce::Identifier AbcomparisonAudioProcessor::SnapshotInvertedChoices = "invertedChoices";
+const juce::Identifier AbcomparisonAudioProcessor::CycleOrder = "cycleOrder";
+const juce::Identifier AbcomparisonAudioProcessor::OSCOutTarget = "OSCOutTarget";
+const juce::Identifier AbcomparisonAudioProcessor::ChoiceTrims = "choiceTrims";
+const juce::Identifier AbcomparisonAudioProcessor::InvertedChoices = "invertedChoices";
+const juce::Identifier AbcomparisonAudioProcessor::ChoiceDelays = "choiceDelays";
+const juce::Identifier AbcomparisonAudioProcessor::NothingSelected = "nothingSelected";
 
 //==============================================================================
-AbcomparisonAudioProcessor::AbcomparisonAudioProcessor()
-#ifndef JucePlugin_PreferredChannelConfigurations
-     : AudioProcessor (BusesProperties()
+juce::AudioProcessor::BusesProperties AbcomparisonAudioProcessor::createBusesProperties()
+{
+    auto properties = BusesProperties()
                      #if ! JucePlugin_IsMidiEffect
                       #if ! JucePlugin_IsSynth
                        .withInput  ("Input",  juce::AudioChannelSet::discreteChannels (64), true)
                       #endif
                        .withOutput ("Output", juce::AudioChannelSet::discreteChannels (64), true)
                      #endif
-                       ),
+                       ;
+
+    // optional side-chain inputs, one for each choice except the first one, which is on the main bus;
+    // not for VST2, which can't disable buses: its wrapper enables all of them, so every choice would read its side-chain input
+    if (juce::PluginHostType::getPluginLoadedAs() != wrapperType_VST)
+        for (int choice = 1; choice < maxNChoices; ++choice)
+            properties.addBus (true, "Choice " + juce::String (choice + 1), juce::AudioChannelSet::stereo(), false);
+
+    return properties;
+}
+
+AbcomparisonAudioProcessor::AbcomparisonAudioProcessor()
+#ifndef JucePlugin_PreferredChannelConfigurations
+     : AudioProcessor (createBusesProperties()),
 #endif
-parameters (*this, nullptr, "ABComparison", createParameters()),
-oscReceiver (9222)
+parameters (*this, nullptr, "ABComparison", createParameters())
 {
+    std::fill (std::begin (sideChainFirstChannel), std::end (sideChainFirstChannel), -1);
+
     for (int choice = 0; choice < maxNChoices; ++choice)
     {
-        parameters.addParameterListener ("choiceState" + juce::String (choice), this);
         choiceStates[choice] = parameters.getRawParameterValue ("choiceState" + juce::String (choice));
+        choiceStateParameters[choice] = parameters.getParameter ("choiceState" + juce::String (choice));
     }
 
     parameters.addParameterListener ("numberOfChoices", this);
+    parameters.addParameterListener ("selectedChoice", this);
 
-    parameters.addParameterListener ("fadeTime", this);
     switchMode = parameters.getRawParameterValue ("switchMode");
     fadeTime = parameters.getRawParameterValue ("fadeTime");
+    zeroCrossingSwitch = parameters.getRawParameterValue ("zeroCrossingSwitch");
+    foldDownPreset = parameters.getRawParameterValue ("foldDown");
+    snapshotParameter = parameters.getRawParameterValue ("snapshot");
+    quantization = parameters.getRawParameterValue ("quantization");
+    gridLength = parameters.getRawParameterValue ("gridLength");
+    autoCycle = parameters.getRawParameterValue ("autoCycle");
+    cycleInterval = parameters.getRawParameterValue ("cycleInterval");
+    cycleUnit = parameters.getRawParameterValue ("cycleUnit");
+    selectedChoice = parameters.getRawParameterValue ("selectedChoice");
+    differenceMode = parameters.getRawParameterValue ("difference");
+    differenceA = parameters.getRawParameterValue ("differenceA");
+    differenceB = parameters.getRawParameterValue ("differenceB");
+    differenceGain = parameters.getRawParameterValue ("differenceGain");
     numberOfChoices = parameters.getRawParameterValue ("numberOfChoices");
+    channelSize = parameters.getRawParameterValue ("channelSize");
+
+    switchModeParameter = parameters.getParameter ("switchMode");
+    fadeTimeParameter = parameters.getParameter ("fadeTime");
+    snapshotRecallParameter = parameters.getParameter ("snapshot");
+    selectedChoiceParameter = parameters.getParameter ("selectedChoice");
 
-    oscReceiver.addListener (this, juce::OSCAddress ("/switch"));
+    formatManager.registerBasicFormats();
+
+    oscId = sharedOSCReceiver->addClient (this);
+
+    startTimer (50);
 }
 
 
 AbcomparisonAudioProcessor::~AbcomparisonAudioProcessor()
 {
+    sharedOSCReceiver->removeClient (this);
 }
 
 //==============================================================================
@@ -131,11 +189,41 @@ void AbcomparisonAudioProcessor::changeProgramName (int index, const juce::Strin
 //==============================================================================
 void AbcomparisonAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
+    engine.prepare (sampleRate, samplesPerBlock);
+    updateFadeLength (*fadeTime);
+
+    // in exclusive solo, the selected choice plays, the choices' own parameters are only followed in toggle mode
+    wasExclusive = *switchMode < 0.5f;
+    lastSelectedChoice = getSelectedChoice();
+
     for (int choice = 0; choice < maxNChoices; ++choice)
     {
-        gains[choice].reset (sampleRate, *fadeTime / 1000.0f);
-        gains[choice].setCurrentAndTargetValue (*choiceStates[choice] < 0.5f ? 0.0f : 1.0f);
+        lastChoiceStates[choice] = *choiceStates[choice] >= 0.5f;
+        const bool state = wasExclusive ? choice == lastSelectedChoice : lastChoiceStates[choice];
+        targetStates[choice] = state;
+        engine.resetChoice (choice, state);
     }
+
+    lastSnapshotParameter = juce::roundToInt (snapshotParameter->load());
+
+    engine.resetDifference (*differenceMode >= 0.5f && juce::roundToInt (differenceA->load()) != juce::roundToInt (differenceB->load()),
+                            juce::Decibels::decibelsToGain (differenceGain->load()));
+    analyzerTap.prepare (sampleRate);
+
+    // where the side-chain inputs of the choices are within the buffer
+    mainBusNumInputChannels = getMainBusNumInputChannels();
+    for (int choice = 1; choice < maxNChoices; ++choice)
+    {
+        const auto* bus = getBus (true, choice);
+        const bool isConnected = bus != nullptr && bus->isEnabled() && bus->getNumberOfChannels() > 0;
+        sideChainFirstChannel[choice] = isConnected ? getChannelIndexInProcessBlockBuffer (true, choice, 0) : -1;
+        sideChainNumChannels[choice] = isConnected ? bus->getNumberOfChannels() : 0;
+    }
+
+    const juce::SpinLock::ScopedLockType lock (filePlayersLock);
+    for (auto& player : filePlayers)
+        if (player != nullptr)
+            player->prepare (samplesPerBlock);
 }
 
 void AbcomparisonAudioProcessor::releaseResources()
@@ -147,56 +235,569 @@ void AbcomparisonAudioProcessor::releaseResources()
 #ifndef JucePlugin_PreferredChannelConfigurations
 bool AbcomparisonAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
 {
+    // the side-chain inputs of the choices can be disabled or have any layout up to the maximum channel size
+    for (int bus = 1; bus < layouts.inputBuses.size(); ++bus)
+        if (layouts.getNumChannels (true, bus) > maxChannelSize)
+            return false;
+
     return true;
 }
 #endif
 
 void AbcomparisonAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
+    ABC_TRACE_THREAD ("audio");
+    ABC_TRACE_SCOPE ("processBlock");
+    ABC_REALTIME_SCOPE ("processBlock");
+
     juce::ScopedNoDenormals noDenormals;
     auto nCh = buffer.getNumChannels();
-    const int stride = *parameters.getRawParameterValue ("channelSize") + 1;
+    const int stride = *channelSize + 1;
     auto nSamples = buffer.getNumSamples();
-    // choice 0
-    if (! gains[0].isSmoothing() && gains[0].getTargetValue() == 0.0f)
+    const int nChoices = *numberOfChoices + 2;
+    const bool exclusive = *switchMode < 0.5f;
+
+    // while a recalled snapshot's fade time hasn't made it into the parameter yet, the parameter is outdated
+    if (*fadeTime != lastFadeTime && recalledSnapshot.load() < 0)
+        updateFadeLength (*fadeTime);
+
+    engine.setZeroCrossingSwitch (*zeroCrossingSwitch >= 0.5f);
+    engine.setDifference (*differenceMode >= 0.5f, juce::roundToInt (differenceA->load()), juce::roundToInt (differenceB->load()),
+                          juce::Decibels::decibelsToGain (differenceGain->load()));
+
+    // the host's transport, read once per block
+    juce::Optional<juce::AudioPlayHead::PositionInfo> position;
+    if (auto* playHead = getPlayHead())
+        position = playHead->getPosition();
+
+    numEvents = 0;
+    addCarriedEvents();
+
+    // it was quantized already
+    if (snapshotToRetry >= 0)
     {
-        for (int ch = 0; ch < juce::jmin (nCh, stride); ++ch)
-            buffer.clear (ch, 0, nSamples);
+        addEvent ({ 0, snapshotToRetry, SwitchEvent::recallSnapshot, false });
+        snapshotToRetry = -1;
     }
-    else
+    updateQuantizationGrid (position, nSamples);
+    releaseQuantizedEvents (nSamples);
+
+    // entering exclusive solo keeps the first playing choice, the timer updates the parameters of the new mode
+    if (exclusive != wasExclusive)
     {
-        const float startGain = gains[0].getNextValue();
-        gains[0].skip (nSamples - 2);
-        const float endGain = gains[0].getNextValue();
+        wasExclusive = exclusive;
+        for (int choice = 0; choice < maxNChoices; ++choice)
+            choiceStateNeedsSync[choice] = true;
+
+        parametersNeedSync = true;
 
-        for (int ch = 0; ch < juce::jmin (nCh, stride); ++ch)
-            buffer.applyGainRamp (ch, 0, nSamples, startGain, endGain);
+        for (int choice = 0; exclusive && choice < nChoices; ++choice)
+        {
+            if (targetStates[choice].load())
+            {
+                scheduleEvent ({ 0, choice, SwitchEvent::select, false });
+                break;
+            }
+        }
     }
 
-    // remaining choices
+    // parameter changes (GUI, OSC, automation) come without a sample position, so they take effect at the start of the block
+    const int selected = getSelectedChoice();
+    if (selected != lastSelectedChoice)
+    {
+        lastSelectedChoice = selected;
+        if (exclusive)
+            scheduleEvent ({ 0, selected, SwitchEvent::select, true });
+    }
 
-    const int nChoices = *numberOfChoices + 2;
-    for (int choice = 1; choice < nChoices; ++choice)
+    for (int choice = 0; choice < maxNChoices; ++choice)
     {
-        if (gains[choice].isSmoothing() || gains[choice].getTargetValue() != 0.0f)
+        const bool state = *choiceStates[choice] >= 0.5f;
+        if (state == lastChoiceStates[choice])
+            continue;
+
+        lastChoiceStates[choice] = state;
+        if (! exclusive)
+            scheduleEvent ({ 0, choice, state ? SwitchEvent::switchOn : SwitchEvent::switchOff, true });
+        else if (state) // older automation of the choices' own parameters selects them, the selectedChoice parameter follows
+            scheduleEvent ({ 0, choice, SwitchEvent::select, false });
+    }
+
+    const int snapshotValue = juce::roundToInt (snapshotParameter->load());
+    if (snapshotValue != lastSnapshotParameter)
+    {
+        lastSnapshotParameter = snapshotValue;
+        if (snapshotValue > 0)
+            scheduleEvent ({ 0, snapshotValue - 1, SwitchEvent::recallSnapshot, true });
+    }
+
+    const int snapshotToRecall = pendingSnapshot.exchange (-1);
+    if (snapshotToRecall >= 0)
+        scheduleEvent ({ 0, snapshotToRecall, SwitchEvent::recallSnapshot, false });
+
+    // MIDI notes and program changes are sample-accurate
+    for (const auto metadata : midiMessages)
+    {
+        const auto message = metadata.getMessage();
+        if (message.isProgramChange())
         {
-            const float startGain = gains[choice].getNextValue();
-            gains[choice].skip (nSamples - 2);
-            const float endGain = gains[choice].getNextValue();
+            if (message.getProgramChangeNumber() < numSnapshots)
+                scheduleEvent ({ metadata.samplePosition, message.getProgramChangeNumber(), SwitchEvent::recallSnapshot, false });
+
+            continue;
+        }
 
+        if (! message.isNoteOn())
+            continue;
+
+        const int choice = message.getNoteNumber() - midiNoteOfFirstChoice;
+        if (juce::isPositiveAndBelow (choice, nChoices))
+            scheduleEvent ({ metadata.samplePosition, choice, exclusive ? SwitchEvent::select : SwitchEvent::toggle, false });
+    }
+
+    scheduleAutoCycle (position, nChoices, nSamples);
+
+    // the players are only swapped or destroyed while this lock is held, so it's kept until the mixer has read
+    // their output; in the rare case the message thread holds it, the files are silent for one block
+    const juce::SpinLock::ScopedTryLockType filePlayersTryLock (filePlayersLock);
+    updateSources (buffer, stride, nChoices, position, filePlayersTryLock.isLocked());
+    engine.beginBlock (buffer, stride, getMainBusNumOutputChannels(), nChoices, static_cast<FoldDownPresets::Preset> (juce::roundToInt (foldDownPreset->load())));
+
+    // the reference is tapped before the output overwrites it, both are published after rendering
+    const int referenceChoice = analyzerTap.getReferenceChoice();
+    analyzerTap.beginBlock (nSamples);
+    analyzerTap.write (AnalyzerTap::reference, juce::isPositiveAndBelow (referenceChoice, nChoices) ? engine.getSource (referenceChoice, 0) : nullptr);
+
+    // split the block at the events, each sub-block gets its own gain ramps; maxEventsPerBlock bounds the splits
+    int subBlockStart = 0;
+    for (int i = 0; i < numEvents; ++i)
+    {
+        const int eventPosition = juce::jlimit (0, nSamples, events[i].sampleOffset);
+        if (eventPosition > subBlockStart)
+        {
+            engine.render (subBlockStart, eventPosition - subBlockStart);
+            subBlockStart = eventPosition;
+        }
+
+        applyEvent (events[i]);
+    }
+
+    engine.render (subBlockStart, nSamples - subBlockStart);
+    engine.endBlock();
+
+    analyzerTap.write (AnalyzerTap::output, nCh > 0 ? buffer.getReadPointer (0) : nullptr);
+    analyzerTap.endBlock();
+
+    // clear not needed channels
+    for (int ch = engine.getNumOutputChannels(); ch < juce::jmin (nCh, getTotalNumOutputChannels()); ++ch)
+        buffer.clear (ch, 0, nSamples);
+
+}
+
+void AbcomparisonAudioProcessor::updateSources (juce::AudioBuffer<float>& buffer, int stride, int nChoices,
+                                                const juce::Optional<juce::AudioPlayHead::PositionInfo>& position, bool canReadFiles)
+{
+    const int nCh = buffer.getNumChannels();
+    const int nSamples = buffer.getNumSamples();
+
+    const juce::int64 transportPosition = position.hasValue() ? position->getTimeInSamples().orFallback (0) : 0;
+    const bool transportIsPlaying = position.hasValue() && position->getIsPlaying();
+
+    for (int choice = 0; choice < nChoices; ++choice)
+    {
+        if (choiceHasFile[choice].load())
+        {
+            auto* player = canReadFiles && filePlayers[choice] != nullptr && filePlayers[choice]->getFileSampleRate() == getSampleRate()
+                               ? filePlayers[choice].get() : nullptr;
+
+            // all players read every block, so they stay in sync and switching between them is instant
+            const float* const* fileChannels = player != nullptr ? player->read (transportPosition, nSamples, transportIsPlaying) : nullptr;
+            const int nFileChannels = fileChannels != nullptr ? player->getNumChannels() : 0;
+
+            for (int ch = 0; ch < stride; ++ch)
+                engine.setSource (choice, ch, ch < nFileChannels ? fileChannels[ch] : nullptr);
+        }
+        else if (sideChainFirstChannel[choice] >= 0)
+        {
+            // the choice's own input bus, read directly from the host's buffer
+            for (int ch = 0; ch < stride; ++ch)
+            {
+                const int sourceChannel = sideChainFirstChannel[choice] + ch;
+                engine.setSource (choice, ch, ch < sideChainNumChannels[choice] && sourceChannel < nCh ? buffer.getReadPointer (sourceChannel) : nullptr);
+            }
+        }
+        else
+        {
+            // the choices are next to each other on the main bus
             for (int ch = 0; ch < stride; ++ch)
             {
                 const int sourceChannel = choice * stride + ch;
-                if (sourceChannel < nCh)
-                    buffer.addFromWithRamp (ch, 0, buffer.getReadPointer (sourceChannel), nSamples, startGain, endGain);
+                engine.setSource (choice, ch, sourceChannel < juce::jmin (nCh, mainBusNumInputChannels) ? buffer.getReadPointer (sourceChannel) : nullptr);
             }
         }
     }
+}
 
-    // clear not needed channels
-    for (int ch = stride; ch < nCh; ++ch)
-        buffer.clear (ch, 0, nSamples);
+void AbcomparisonAudioProcessor::addEvent (const SwitchEvent& newEvent)
+{
+    // a full block hands its latest event to the next block
+    if (numEvents == maxEventsPerBlock)
+    {
+        if (numCarriedEvents == maxEventsPerBlock)
+            return;
+
+        if (newEvent.sampleOffset >= events[numEvents - 1].sampleOffset)
+        {
+            carriedEvents[numCarriedEvents++] = newEvent;
+            return;
+        }
+
+        carriedEvents[numCarriedEvents++] = events[--numEvents];
+    }
+
+    // keep the events sorted by their position, events at the same position keep their order
+    int i = numEvents++;
+    for (; i > 0 && events[i - 1].sampleOffset > newEvent.sampleOffset; --i)
+        events[i] = events[i - 1];
+
+    events[i] = newEvent;
+}
+
+void AbcomparisonAudioProcessor::addCarriedEvents()
+{
+    // they're at least one block late already, so they come first
+    const int numToAdd = numCarriedEvents;
+    numCarriedEvents = 0;
+
+    for (int i = 0; i < numToAdd; ++i)
+        addEvent ({ 0, carriedEvents[i].choice, carriedEvents[i].type, carriedEvents[i].fromParameter });
+}
+
+void AbcomparisonAudioProcessor::updateQuantizationGrid (const juce::Optional<juce::AudioPlayHead::PositionInfo>& position, int numSamples)
+{
+    const auto mode = static_cast<QuantizationMode> (juce::roundToInt (quantization->load()));
+    const bool wasActive = grid.isActive;
+    const auto expectedBlockStart = grid.blockStart + grid.numSamples;
+
+    grid.isActive = false;
+    grid.numSamples = numSamples;
+
+    // without a running transport there's nothing to quantize to, the switches happen right away
+    if (mode == quantizationOff || ! position.hasValue() || ! position->getIsPlaying() || ! position->getTimeInSamples().hasValue())
+        return;
+
+    grid.mode = mode;
+    grid.blockStart = *position->getTimeInSamples();
+
+    if (mode == quantizeToGrid)
+    {
+        grid.gridLength = juce::jmax (static_cast<juce::int64> (1), static_cast<juce::int64> (getSampleRate() * *gridLength / 1000.0));
+    }
+    else
+    {
+        const auto bpm = position->getBpm();
+        const auto ppq = position->getPpqPosition();
+        if (! bpm.hasValue() || *bpm <= 0.0 || ! ppq.hasValue())
+            return;
+
+        const auto timeSignature = position->getTimeSignature().orFallback (juce::AudioPlayHead::TimeSignature());
+        const double beatLength = 4.0 / juce::jmax (1, timeSignature.denominator);
+
+        grid.samplesPerQuarter = getSampleRate() * 60.0 / *bpm;
+        grid.ppqAtBlockStart = *ppq;
+        grid.lastBarStart = position->getPpqPositionOfLastBarStart().orFallback (0.0);
+        grid.length = mode == quantizeToBar ? beatLength * juce::jmax (1, timeSignature.numerator) : beatLength;
+    }
+
+    grid.isActive = true;
+
+    // after a jump of the transport (e.g. a loop), the deferred switches happen right away
+    grid.transportJumped = wasActive && grid.blockStart != expectedBlockStart;
+}
+
+juce::int64 AbcomparisonAudioProcessor::QuantizationGrid::getNextBoundary (int sampleOffset) const
+{
+    const juce::int64 time = blockStart + sampleOffset;
+
+    if (mode == quantizeToGrid)
+        return static_cast<juce::int64> (std::ceil (static_cast<double> (time) / gridLength)) * gridLength;
+
+    // the small tolerance keeps positions right on a boundary from being pushed to the next one
+    const double ppq = ppqAtBlockStart + sampleOffset / samplesPerQuarter;
+    const double boundary = lastBarStart + std::ceil ((ppq - lastBarStart) / length - 1.0e-6) * length;
+    return juce::jmax (time, blockStart + static_cast<juce::int64> (std::llround ((boundary - ppqAtBlockStart) * samplesPerQuarter)));
+}
+
+void AbcomparisonAudioProcessor::scheduleEvent (const SwitchEvent& event)
+{
+    ABC_TRACE_INSTANT ("dequeue", "choice", event.choice);
+
+    if (! grid.isActive)
+    {
+        addEvent (event);
+        return;
+    }
+
+    const auto boundary = grid.getNextBoundary (event.sampleOffset);
+    if (boundary < grid.blockStart + grid.numSamples || numQuantizedEvents == maxEventsPerBlock)
+    {
+        addEvent ({ static_cast<int> (juce::jmax (static_cast<juce::int64> (event.sampleOffset), boundary - grid.blockStart)),
+                    event.choice, event.type, event.fromParameter });
+        return;
+    }
+
+    // deferred to a later block, the events keep their order
+    quantizedEvents[numQuantizedEvents++] = { boundary, event };
+}
+
+void AbcomparisonAudioProcessor::releaseQuantizedEvents (int numSamples)
+{
+    const bool releaseAll = ! grid.isActive || grid.transportJumped;
+    const auto blockEnd = grid.blockStart + numSamples;
+
+    int numKept = 0;
+    for (int i = 0; i < numQuantizedEvents; ++i)
+    {
+        const auto& quantized = quantizedEvents[i];
+        if (releaseAll || quantized.time < blockEnd)
+        {
+            const int offset = releaseAll ? 0 : static_cast<int> (juce::jmax (static_cast<juce::int64> (0), quantized.time - grid.blockStart));
+            addEvent ({ offset, quantized.event.choice, quantized.event.type, quantized.event.fromParameter });
+        }
+        else
+            quantizedEvents[numKept++] = quantized;
+    }
+
+    numQuantizedEvents = numKept;
+}
+
+void AbcomparisonAudioProcessor::scheduleAutoCycle (const juce::Optional<juce::AudioPlayHead::PositionInfo>& position, int nChoices, int numSamples)
+{
+    const int mode = juce::roundToInt (autoCycle->load());
+    const bool inBars = *cycleUnit >= 0.5f;
+    const float interval = *cycleInterval;
+
+    if (cycleOrderVersion.load() != activeCycleOrderVersion)
+    {
+        // the order is only changed while this lock is held, in that rare case we'll copy it next block
+        const juce::SpinLock::ScopedTryLockType lock (cycleOrderLock);
+        if (lock.isLocked())
+        {
+            std::copy (std::begin (cycleOrder), std::end (cycleOrder), std::begin (activeCycleOrder));
+            activeCycleOrderLength = cycleOrderLength;
+            activeCycleOrderVersion = cycleOrderVersion.load();
+        }
+    }
+
+    if (mode == autoCycleOff)
+    {
+        lastAutoCycleMode = autoCycleOff;
+        cycleChoice = -1;
+        return;
+    }
+
+    // (re)start: the first choice plays right away, the sequence only depends on the settings
+    if (mode != lastAutoCycleMode || interval != lastCycleInterval)
+    {
+        lastAutoCycleMode = mode;
+        lastCycleInterval = interval;
+        cycleClock = 0;
+        cycleSteps = 0;
+        barsSinceLastStep = 0;
+        hasLastBarIndex = false;
+        cycleOrderIndex = -1;
+        cycleRandom.setSeed (0x414243);
+        cycleChoice = -1;
+        stepAutoCycle (0, nChoices);
+    }
+
+    if (! inBars)
+    {
+        // every step time is computed from the start, so rounding errors don't add up over hours
+        const double intervalInSamples = juce::jmax (1.0, getSampleRate() * interval);
+        const auto blockEnd = cycleClock + numSamples;
+
+        for (;;)
+        {
+            const auto nextStep = static_cast<juce::int64> (std::llround ((cycleSteps + 1) * intervalInSamples));
+            if (nextStep >= blockEnd)
+            {
+                cycleRemaining = static_cast<float> ((nextStep - blockEnd) / getSampleRate());
+                break;
+            }
+
+            ++cycleSteps;
+            stepAutoCycle (static_cast<int> (nextStep - cycleClock), nChoices);
+        }
+
+        cycleClock = blockEnd;
+        return;
+    }
+
+    // in bars, the cycle follows the host's bar lines, and waits while the transport is stopped
+    if (! position.hasValue() || ! position->getIsPlaying())
+        return;
+
+    const auto bpm = position->getBpm();
+    const auto ppq = position->getPpqPosition();
+    if (! bpm.hasValue() || *bpm <= 0.0 || ! ppq.hasValue())
+        return;
+
+    const auto timeSignature = position->getTimeSignature().orFallback (juce::AudioPlayHead::TimeSignature());
+    const double barLength = 4.0 * juce::jmax (1, timeSignature.numerator) / juce::jmax (1, timeSignature.denominator);
+    const double samplesPerQuarter = getSampleRate() * 60.0 / *bpm;
+    const double lastBarStart = position->getPpqPositionOfLastBarStart().orFallback (0.0);
+    const int barsPerStep = juce::jmax (1, juce::roundToInt (interval));
+
+    // bar lines are numbered, a line belongs to the block it starts in; counting the lines between the last
+    // counted one and the block's end, no line is skipped or counted twice when it rounds to a block boundary
+    const auto firstBarIndex = std::llround (lastBarStart / barLength);
+    const auto barIndexBefore = [&] (double ppqPosition)
+    {
+        return firstBarIndex + static_cast<juce::int64> (std::floor ((ppqPosition - lastBarStart - 1.0e-6) / barLength));
+    };
+
+    const auto indexAtStart = barIndexBefore (*ppq);
+    const auto indexAtEnd = barIndexBefore (*ppq + numSamples / samplesPerQuarter);
+
+    // after starting, or when the transport jumped, counting goes on from here
+    if (! hasLastBarIndex || indexAtStart < lastBarIndex || indexAtStart > lastBarIndex + 1)
+    {
+        lastBarIndex = indexAtStart;
+        hasLastBarIndex = true;
+    }
+
+    while (lastBarIndex < indexAtEnd)
+    {
+        const double barLine = lastBarStart + static_cast<double> (++lastBarIndex - firstBarIndex) * barLength;
+        const auto offset = juce::jlimit (static_cast<juce::int64> (0), static_cast<juce::int64> (numSamples - 1),
+                                          static_cast<juce::int64> (std::llround ((barLine - *ppq) * samplesPerQuarter)));
+
+        if (++barsSinceLastStep >= barsPerStep)
+        {
+            barsSinceLastStep = 0;
+            stepAutoCycle (static_cast<int> (offset), nChoices);
+        }
+    }
+
+    cycleRemaining = static_cast<float> (barsPerStep - barsSinceLastStep);
+}
+
+void AbcomparisonAudioProcessor::stepAutoCycle (int sampleOffset, int nChoices)
+{
+    const int current = cycleChoice.load();
+    int next = (current + 1) % nChoices;
+
+    if (lastAutoCycleMode == cycleRandom && nChoices > 1)
+    {
+        // never the same choice twice in a row
+        next = cycleRandom.nextInt (current < 0 ? nChoices : nChoices - 1);
+        if (current >= 0 && next >= current)
+            ++next;
+    }
+    else if (lastAutoCycleMode == cycleUserOrder && activeCycleOrderLength > 0)
+    {
+        // choices beyond the number of choices are skipped
+        for (int i = 0; i < activeCycleOrderLength; ++i)
+        {
+            cycleOrderIndex = (cycleOrderIndex + 1) % activeCycleOrderLength;
+            if (activeCycleOrder[cycleOrderIndex] < nChoices)
+            {
+                next = activeCycleOrder[cycleOrderIndex];
+                break;
+            }
+        }
+    }
+
+    cycleChoice = next;
+    ++cycleStepCount;
+    addEvent ({ sampleOffset, next, SwitchEvent::select, false });
+}
+
+void AbcomparisonAudioProcessor::applyEvent (const SwitchEvent& event)
+{
+    ABC_TRACE_INSTANT ("applyEvent", "choice", event.choice);
+
+    switch (event.type)
+    {
+        case SwitchEvent::select:
+            if (event.choice >= 0) // -1 switches all choices off
+                nothingSelected = false;
+
+            for (int choice = 0; choice < maxNChoices; ++choice)
+                setTargetState (choice, choice == event.choice, event.fromParameter);
+            break;
+
+        case SwitchEvent::switchOn:
+            setTargetState (event.choice, true, event.fromParameter);
+            break;
+
+        case SwitchEvent::switchOff:
+            setTargetState (event.choice, false, event.fromParameter);
+            break;
+
+        case SwitchEvent::toggle:
+            setTargetState (event.choice, ! targetStates[event.choice].load(), event.fromParameter);
+            break;
+
+        case SwitchEvent::recallSnapshot:
+            applySnapshot (event.choice);
+            break;
+    }
+}
+
+void AbcomparisonAudioProcessor::applySnapshot (const int index)
+{
+    // the snapshots are only changed while this lock is held, in that rare case the recall is tried again next block
+    const juce::SpinLock::ScopedTryLockType lock (snapshotsLock);
+    if (! lock.isLocked())
+    {
+        snapshotToRetry = index;
+        return;
+    }
 
+    if (! snapshots[index].isStored)
+        return;
+
+    const auto& snapshot = snapshots[index];
+
+    // the new fade time already applies to this switch
+    if (snapshot.fadeTime != lastFadeTime)
+        updateFadeLength (snapshot.fadeTime);
+
+    if (snapshot.hasTrims)
+        engine.getAlignment().applyTrimsAndPolarities (snapshot.trims, snapshot.invertedChoices);
+
+    for (int choice = 0; choice < maxNChoices; ++choice)
+        setTargetState (choice, snapshot.choiceStates[choice], false);
+
+    // the timer writes fade time, mode and snapshot number back to the parameters, and the trims to the settings
+    lastSnapshotParameter = index + 1;
+    recalledSnapshot = index;
+    parametersNeedSync = true;
+}
+
+void AbcomparisonAudioProcessor::setTargetState (const int choice, const bool state, const bool fromParameter)
+{
+    if (targetStates[choice].load() == state)
+        return;
+
+    targetStates[choice] = state;
+    engine.setChoice (choice, state);
+
+    // the parameters have to follow switches which didn't come from them
+    if (! fromParameter)
+    {
+        choiceStateNeedsSync[choice] = true;
+        parametersNeedSync = true;
+    }
+}
+
+//==============================================================================
+void AbcomparisonAudioProcessor::updateFadeLength (const float fadeTimeInMs)
+{
+    lastFadeTime = fadeTimeInMs;
+    engine.setFadeLength (juce::roundToInt (engine.getSampleRate() * lastFadeTime / 1000.0f));
 }
 
 //==============================================================================
@@ -214,8 +815,53 @@ juce::AudioProcessorEditor* AbcomparisonAudioProcessor::createEditor()
 void AbcomparisonAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
     auto state = parameters.copyState();
-    state.setProperty (OSCPort, oscReceiver.getPortNumber(), nullptr);
-    state.setProperty (OSCEnabled, oscReceiver.getAutoConnect(), nullptr);
+    state.setProperty (OSCPort, getOSCReceiver().getPortNumber(), nullptr);
+    state.setProperty (OSCEnabled, isOSCEnabled(), nullptr);
+    state.setProperty (OSCName, getOSCName(), nullptr);
+    state.setProperty (FoldDownUserMatrix, getFoldDownMatrix(), nullptr);
+    state.setProperty (CycleOrder, getCycleOrder(), nullptr);
+    state.setProperty (OSCOutTarget, getOSCOutTarget(), nullptr);
+    state.setProperty (ChoiceTrims, getChoiceTrims(), nullptr);
+    state.setProperty (InvertedChoices, getInvertedChoices(), nullptr);
+    state.setProperty (ChoiceDelays, getChoiceDelays(), nullptr);
+    state.setProperty (NothingSelected, nothingSelected.load(), nullptr);
+
+    juce::ValueTree snapshotStates (Snapshots);
+    for (int index = 0; index < numSnapshots; ++index)
+    {
+        const auto& snapshot = snapshots[index];
+        if (! snapshot.isStored)
+            continue;
+
+        juce::String choices;
+        for (int choice = 0; choice < maxNChoices; ++choice)
+            choices << (snapshot.choiceStates[choice] ? "1" : "0");
+
+        juce::ValueTree snapshotState (SnapshotState, { { SnapshotIndex, index }, { SnapshotChoices, choices },
+                                                        { SnapshotFadeTime, snapshot.fadeTime },
+                                                        { SnapshotToggleMode, snapshot.toggleMode } });
+
+        if (snapshot.hasTrims)
+        {
+            snapshotState.setProperty (SnapshotTrims, Engine::Alignment::formatTrims (snapshot.trims), nullptr);
+            snapshotState.setProperty (SnapshotInvertedChoices, Engine::Alignment::formatInvertedChoices (snapshot.invertedChoices), nullptr);
+        }
+
+        snapshotStates.appendChild (snapshotState, nullptr);
+    }
+    state.removeChild (state.getChildWithName (Snapshots), nullptr);
+    state.appendChild (snapshotStates, nullptr);
+
+    juce::ValueTree files (AudioFiles);
+    for (int choice = 0; choice < maxNChoices; ++choice)
+    {
+        const auto file = getFile (choice);
+        if (file != juce::File())
+            files.appendChild (juce::ValueTree (AudioFile, { { ChoiceIndex, choice }, { FilePath, file.getFullPathName() } }), nullptr);
+    }
+    state.removeChild (state.getChildWithName (AudioFiles), nullptr);
+    state.appendChild (files, nullptr);
+
     std::unique_ptr<juce::XmlElement> xml (state.createXml());
     copyXmlToBinary (*xml, destData);
 }
@@ -227,6 +873,25 @@ void AbcomparisonAudioProcessor::setStateInformation (const void* data, int size
         if (xmlState->hasTagName (parameters.state.getType()))
         {
             parameters.replaceState (juce::ValueTree::fromXml (*xmlState));
+
+            // sessions from before the selectedChoice parameter keep their selection, or that nothing is selected
+            bool noSelection = parameters.state.getProperty (NothingSelected, false);
+            if (xmlState->getChildByAttribute ("id", "selectedChoice") == nullptr)
+            {
+                noSelection = true;
+                for (int choice = 0; choice < maxNChoices; ++choice)
+                {
+                    if (*choiceStates[choice] >= 0.5f)
+                    {
+                        selectedChoiceParameter->setValueNotifyingHost (selectedChoiceParameter->convertTo0to1 (static_cast<float> (choice)));
+                        noSelection = false;
+                        break;
+                    }
+                }
+            }
+
+            nothingSelected = noSelection;
+
             if (parameters.state.hasProperty (EditorWidth) && parameters.state.hasProperty (EditorHeight))
             {
                 editorWidth = parameters.state.getProperty (EditorWidth);
@@ -240,52 +905,346 @@ void AbcomparisonAudioProcessor::setStateInformation (const void* data, int size
             if (parameters.state.hasProperty (ButtonSize))
                 setButtonSize (parameters.state.getProperty (ButtonSize));
 
-            if (parameters.state.hasProperty (OSCPort))
-                oscReceiver.setPort (parameters.state.getProperty (OSCPort));
+            if (parameters.state.hasProperty (OSCName))
+                setOSCName (parameters.state.getProperty (OSCName));
 
             if (parameters.state.hasProperty (OSCEnabled))
-                oscReceiver.setAutoConnect (parameters.state.getProperty (OSCEnabled));
+                setOSCEnabled (parameters.state.getProperty (OSCEnabled));
+
+            // the port is shared by all instances, only a session using OSC moves it
+            if (parameters.state.hasProperty (OSCPort) && isOSCEnabled())
+            {
+                const int port = parameters.state.getProperty (OSCPort);
+                if (port != getOSCReceiver().getPortNumber())
+                    getOSCReceiver().setPort (port);
+            }
+
+            if (parameters.state.hasProperty (FoldDownUserMatrix))
+                setFoldDownMatrix (parameters.state.getProperty (FoldDownUserMatrix));
+
+            if (parameters.state.hasProperty (CycleOrder))
+                setCycleOrder (parameters.state.getProperty (CycleOrder));
+
+            if (parameters.state.hasProperty (OSCOutTarget))
+                setOSCOutTarget (parameters.state.getProperty (OSCOutTarget));
+
+            if (parameters.state.hasProperty (ChoiceTrims))
+                setChoiceTrims (parameters.state.getProperty (ChoiceTrims));
+
+            if (parameters.state.hasProperty (InvertedChoices))
+                setInvertedChoices (parameters.state.getProperty (InvertedChoices));
+
+            if (parameters.state.hasProperty (ChoiceDelays))
+                setChoiceDelays (parameters.state.getProperty (ChoiceDelays));
+
+            const auto snapshotStates = parameters.state.getChildWithName (Snapshots);
+            for (int index = 0; index < numSnapshots; ++index)
+            {
+                const auto snapshotState = snapshotStates.getChildWithProperty (SnapshotIndex, index);
+
+                Snapshot snapshot;
+                snapshot.isStored = snapshotState.isValid();
+                if (snapshot.isStored)
+                {
+                    const auto choices = snapshotState.getProperty (SnapshotChoices).toString();
+                    for (int choice = 0; choice < juce::jmin (maxNChoices, choices.length()); ++choice)
+                        snapshot.choiceStates[choice] = choices[choice] == '1';
+
+                    snapshot.fadeTime = snapshotState.getProperty (SnapshotFadeTime, 50.0f);
+                    snapshot.toggleMode = snapshotState.getProperty (SnapshotToggleMode, false);
+
+                    if (snapshotState.hasProperty (SnapshotTrims) && snapshotState.hasProperty (SnapshotInvertedChoices))
+                        snapshot.hasTrims = Engine::Alignment::parseTrims (snapshotState.getProperty (SnapshotTrims), snapshot.trims)
+                                         && Engine::Alignment::parseInvertedChoices (snapshotState.getProperty (SnapshotInvertedChoices), snapshot.invertedChoices);
+                }
+
+                const juce::SpinLock::ScopedLockType lock (snapshotsLock);
+                snapshots[index] = snapshot;
+            }
+
+            const auto files = parameters.state.getChildWithName (AudioFiles);
+            for (int choice = 0; choice < maxNChoices; ++choice)
+            {
+                const auto file = files.getChildWithProperty (ChoiceIndex, choice);
+                if (file.isValid())
+                    loadFile (choice, juce::File (file.getProperty (FilePath).toString()));
+                else
+                    unloadFile (choice);
+            }
         }
 }
 
 void AbcomparisonAudioProcessor::parameterChanged (const juce::String &parameterID, float newValue)
 {
-    if (parameterID.startsWith ("choiceState"))
+    ABC_REALTIME_SCOPE ("parameterChanged"); // some hosts call it from the audio thread
+
+    // the switches are handled by processBlock, which polls the parameters
+    if (parameterID == "numberOfChoices")
     {
-        auto choice = parameterID.substring (11).getIntValue();
-        const bool wasOnBefore = gains[choice].getTargetValue() == 1.0f;
-        gains[choice].setTargetValue (newValue);
-        if (*switchMode < 0.5f && ! mutingOtherChoices) // exclusive solo
+        // the tracer only stores literals, so the parameter's ID is the argument's name
+        ABC_TRACE_INSTANT ("parameterChanged", "numberOfChoices", juce::roundToInt (newValue));
+        numberOfChoicesHasChanged = true;
+    }
+    else if (parameterID == "selectedChoice")
+    {
+        ABC_TRACE_INSTANT ("parameterChanged", "selectedChoice", juce::roundToInt (newValue));
+        nothingSelected = false;
+    }
+    else
+    {
+        ABC_TRACE_INSTANT ("parameterChanged", "unknownParameter", juce::roundToInt (newValue));
+    }
+}
+
+void AbcomparisonAudioProcessor::timerCallback()
+{
+    ABC_TRACE_SCOPE ("processorTimer");
+
+    // auto-cycle steps are sent from here, the audio thread doesn't touch the network
+    const int cycleStep = cycleStepCount.load();
+    if (cycleStep != lastSentCycleStep)
+    {
+        lastSentCycleStep = cycleStep;
+        const int choice = cycleChoice.load();
+        if (oscOutTarget.isNotEmpty() && choice >= 0)
+            oscSender.send ("/abc/" + juce::String (oscId) + "/cycle", choice + 1);
+    }
+
+    if (! parametersNeedSync.exchange (false))
+        return;
+
+    // the mode has to be set first, it decides which parameters follow the choices
+    int recalled = recalledSnapshot.load();
+    if (recalled >= 0)
+    {
+        Snapshot snapshot;
+        {
+            // a copy, the parameters' listeners are called outside of the lock
+            const juce::SpinLock::ScopedLockType lock (snapshotsLock);
+            snapshot = snapshots[recalled];
+        }
+
+        auto setParameter = [] (juce::RangedAudioParameter* param, float value)
+        {
+            param->setValueNotifyingHost (param->convertTo0to1 (value));
+        };
+
+        setParameter (switchModeParameter, snapshot.toggleMode ? 1.0f : 0.0f);
+        setParameter (fadeTimeParameter, snapshot.fadeTime);
+        setParameter (snapshotRecallParameter, recalled + 1.0f);
+
+        // the audio thread already plays with the snapshot's trims, the settings follow
+        if (snapshot.hasTrims)
+        {
+            setChoiceTrims (Engine::Alignment::formatTrims (snapshot.trims));
+            setInvertedChoices (Engine::Alignment::formatInvertedChoices (snapshot.invertedChoices));
+        }
+    }
+
+    if (*switchMode < 0.5f)
+    {
+        // exclusive solo: a single parameter change, the choices' own parameters are left as they are
+        bool selectionChanged = false;
+        for (int choice = 0; choice < maxNChoices; ++choice)
+            selectionChanged = choiceStateNeedsSync[choice].exchange (false) || selectionChanged;
+
+        for (int choice = 0; selectionChanged && choice < maxNChoices; ++choice)
         {
-            if (wasOnBefore)
-                parameters.getParameter ("choiceState" + juce::String (choice))->setValueNotifyingHost (1.0f);
-            else
-                muteAllOtherChoices (choice);
+            if (targetStates[choice].load())
+            {
+                if (juce::roundToInt (selectedChoice->load()) != choice)
+                    selectedChoiceParameter->setValueNotifyingHost (selectedChoiceParameter->convertTo0to1 (static_cast<float> (choice)));
+
+                break;
+            }
         }
     }
-    else if (parameterID == "fadeTime")
+    else
     {
-        auto sampleRate = getSampleRate();
         for (int choice = 0; choice < maxNChoices; ++choice)
-            gains[choice].reset (sampleRate, *fadeTime / 1000.0f);
+        {
+            if (! choiceStateNeedsSync[choice].exchange (false))
+                continue;
+
+            auto* param = choiceStateParameters[choice];
+            const float value = targetStates[choice].load() ? 1.0f : 0.0f;
+            if (param->getValue() != value)
+                param->setValueNotifyingHost (value);
+        }
+    }
+
+    // unless another snapshot has been recalled in the meantime
+    if (recalled >= 0)
+        recalledSnapshot.compare_exchange_strong (recalled, -1);
+}
+
+bool AbcomparisonAudioProcessor::setCycleOrder (const juce::String& order)
+{
+    auto tokens = juce::StringArray::fromTokens (order, " ,;", "");
+    tokens.removeEmptyStrings();
+
+    if (tokens.size() > maxNChoices)
+        return false;
+
+    int newOrder[maxNChoices] = {};
+    for (int i = 0; i < tokens.size(); ++i)
+    {
+        const int choice = tokens[i].getIntValue() - 1; // `1` is the first choice
+        if (! tokens[i].containsOnly ("0123456789") || ! juce::isPositiveAndBelow (choice, maxNChoices))
+            return false;
+
+        newOrder[i] = choice;
     }
-    else if (parameterID == "numberOfChoices")
+
     {
-        numberOfChoicesHasChanged = true;
+        const juce::SpinLock::ScopedLockType lock (cycleOrderLock);
+        std::copy (std::begin (newOrder), std::end (newOrder), std::begin (cycleOrder));
+        cycleOrderLength = tokens.size();
+        cycleOrderText = order.trim();
+    }
+
+    ++cycleOrderVersion;
+    return true;
+}
+
+juce::String AbcomparisonAudioProcessor::getCycleOrder() const
+{
+    const juce::SpinLock::ScopedLockType lock (cycleOrderLock);
+    return cycleOrderText;
+}
+
+bool AbcomparisonAudioProcessor::setOSCOutTarget (const juce::String& hostAndPort)
+{
+    oscSender.disconnect();
+    oscOutTarget = {};
+
+    if (hostAndPort.trim().isEmpty())
+        return true;
+
+    const auto host = hostAndPort.upToLastOccurrenceOf (":", false, false).trim();
+    const int port = hostAndPort.fromLastOccurrenceOf (":", false, false).getIntValue();
+    if (host.isEmpty() || ! juce::isPositiveAndBelow (port, 65536) || ! oscSender.connect (host, port))
+        return false;
+
+    oscOutTarget = hostAndPort.trim();
+    return true;
+}
+
+void AbcomparisonAudioProcessor::storeSnapshot (const int index)
+{
+    Snapshot snapshot;
+    snapshot.isStored = true;
+    for (int choice = 0; choice < maxNChoices; ++choice)
+        snapshot.choiceStates[choice] = isChoiceOn (choice);
+
+    snapshot.fadeTime = *fadeTime;
+    snapshot.toggleMode = *switchMode >= 0.5f;
+
+    engine.getAlignment().getTrimsAndPolarities (snapshot.trims, snapshot.invertedChoices);
+    snapshot.hasTrims = true;
+
+    const juce::SpinLock::ScopedLockType lock (snapshotsLock);
+    snapshots[index] = snapshot;
+}
+
+void AbcomparisonAudioProcessor::clearSnapshot (const int index)
+{
+    const juce::SpinLock::ScopedLockType lock (snapshotsLock);
+    snapshots[index].isStored = false;
+}
+
+void AbcomparisonAudioProcessor::recallSnapshot (const int index)
+{
+    ABC_TRACE_INSTANT ("enqueueSnapshot", "snapshot", index);
+
+    if (juce::isPositiveAndBelow (index, numSnapshots))
+        pendingSnapshot = index;
+}
+
+void AbcomparisonAudioProcessor::switchChoice (const int choice)
+{
+    if (! juce::isPositiveAndBelow (choice, maxNChoices))
+        return;
+
+    if (*switchMode < 0.5f) // exclusive solo
+    {
+        nothingSelected = false; // the parameter might already have this value
+        selectedChoiceParameter->setValueNotifyingHost (selectedChoiceParameter->convertTo0to1 (static_cast<float> (choice)));
     }
+    else
+    {
+        auto* param = choiceStateParameters[choice];
+        param->setValueNotifyingHost (param->getValue() >= 0.5f ? 0.0f : 1.0f);
+    }
+}
+
+bool AbcomparisonAudioProcessor::isChoiceOn (const int choice) const
+{
+    if (*switchMode < 0.5f)
+        return getSelectedChoice() == choice;
+
+    return *choiceStates[choice] >= 0.5f;
+}
+
+
+void AbcomparisonAudioProcessor::setOSCEnabled (bool shouldBeEnabled)
+{
+    oscEnabled = shouldBeEnabled;
+    sharedOSCReceiver->updateConnection();
+}
+
+void AbcomparisonAudioProcessor::setOSCName (const juce::String& newName)
+{
+    sharedOSCReceiver->setClientName (this, newName);
 }
 
-void AbcomparisonAudioProcessor::muteAllOtherChoices (const int choiceNotToMute)
+void AbcomparisonAudioProcessor::oscCommandReceived (const juce::String& command, const juce::OSCMessage& msg)
 {
-    juce::ScopedValueSetter<bool> muting (mutingOtherChoices, true);
+    if (command == "switch")
+        oscSwitchMessageReceived (msg);
+    else if (command == "snapshot")
+        oscSnapshotMessageReceived (msg);
+   #if ABCOMPARISON_TRACING
+    else if (command == "trace")
+        oscTraceMessageReceived (msg);
+   #endif
+}
 
-    for (int i = 0; i < maxNChoices; ++i)
-        if (i != choiceNotToMute)
-            parameters.getParameter ("choiceState" + juce::String (i))->setValueNotifyingHost (0.0f);
+#if ABCOMPARISON_TRACING
+void AbcomparisonAudioProcessor::oscTraceMessageReceived (const juce::OSCMessage& msg)
+{
+    // `/trace 1` starts recording, `/trace 0` stops it, `/trace "name"` writes the trace to name.json in the traces folder
+    if (msg.size() == 0)
+        return;
+
+    if (msg[0].isInt32())
+    {
+        EventTracer::getInstance().setEnabled (msg[0].getInt32() != 0);
+    }
+    else if (msg[0].isString())
+    {
+        // anyone on the network can send this, so it only takes a plain file name, never a path
+        const auto name = msg[0].getString();
+        if (name.isEmpty() || name != juce::File::createLegalFileName (name) || name.startsWithChar ('.'))
+            return;
+
+        const auto folder = juce::File::getSpecialLocation (juce::File::userApplicationDataDirectory).getChildFile ("ABComparison").getChildFile ("Traces");
+        if (folder.createDirectory().wasOk())
+            EventTracer::getInstance().writeChromeTrace (folder.getChildFile (name).withFileExtension ("json"));
+    }
 }
+#endif
 
+void AbcomparisonAudioProcessor::oscSnapshotMessageReceived (const juce::OSCMessage& msg)
+{
+    // `/snapshot i` recalls snapshot i, starting at 1
+    if (msg.size() > 0 && msg[0].isInt32())
+        recallSnapshot (msg[0].getInt32() - 1);
+    else if (msg.size() > 0 && msg[0].isFloat32())
+        recallSnapshot (juce::roundToInt (msg[0].getFloat32()) - 1);
+}
 
-void AbcomparisonAudioProcessor::oscMessageReceived (const juce::OSCMessage& msg)
+void AbcomparisonAudioProcessor::oscSwitchMessageReceived (const juce::OSCMessage& msg)
 {
     for (auto& arg : msg)
     {
@@ -298,20 +1257,19 @@ void AbcomparisonAudioProcessor::oscMessageReceived (const juce::OSCMessage& msg
             continue;
 
         choice -= 1; // for `1` changing the first one
-        
-        if (choice >= 0 && choice < maxNChoices)
-        {
-            auto param = parameters.getParameter ("choiceState" + juce::String (choice));
-            
-            if (param->getValue() > 0.5f)
-                param->setValueNotifyingHost (0.0f);
-            else
-                param->setValueNotifyingHost (1.0f);
-        }
+
+        ABC_TRACE_INSTANT ("enqueueSwitch", "choice", choice);
+        switchChoice (choice);
     }
 }
 
 
+juce::String AbcomparisonAudioProcessor::getChoiceName (const int choice)
+{
+    // A to Z, numbers for larger capacities
+    return choice < 26 ? juce::String::charToString (static_cast<juce::juce_wchar> ('A' + choice)) : juce::String (choice + 1);
+}
+
 juce::AudioProcessorValueTreeState::ParameterLayout AbcomparisonAudioProcessor::createParameters()
 {
     std::vector<std::unique_ptr<juce::RangedAudioParameter>> params;
@@ -327,7 +1285,7 @@ juce::AudioProcessorValueTreeState::ParameterLayout AbcomparisonAudioProcessor::
                                                    nullptr));
 
     params.push_back (std::make_unique<Parameter> ("channelSize", "Output Channel Size", "channel (s)", // has an offset of 1!
-        juce::NormalisableRange<float> (0.0f, 31.0f, 1.0f), 1.0f, // default is stereo (2 channels)
+        juce::NormalisableRange<float> (0.0f, maxChannelSize - 1.0f, 1.0f), 1.0f, // default is stereo (2 channels)
                                                    [](float value) { return juce::String (value + 1, 0); },
                                                    nullptr));
 
@@ -338,11 +1296,78 @@ juce::AudioProcessorValueTreeState::ParameterLayout AbcomparisonAudioProcessor::
 
     for (int choice = 0; choice < maxNChoices; ++choice)
         params.push_back (std::make_unique<Parameter> ("choiceState" + juce::String (choice),
-                                                       "Choice " + juce::String::charToString (char ('A' + choice)), "",
+                                                       "Choice " + getChoiceName (choice), "",
             juce::NormalisableRange<float> (0.0f, 1.0f, 1.0f), 0.0f,
                                                        [](float value) { return value >= 0.5f ? "ON" :  "OFF"; },
                                                        nullptr, true));
 
+    // new parameters are appended, so VST2 hosts keep the parameter indices of older versions
+    params.push_back (std::make_unique<Parameter> ("zeroCrossingSwitch", "Zero-crossing switch", "",
+        juce::NormalisableRange<float> (0.0f, 1.0f, 1.0f), 0.0f,
+                                                   [](float value) { return value >= 0.5f ? "ON" : "OFF"; },
+                                                   nullptr));
+
+    params.push_back (std::make_unique<Parameter> ("foldDown", "Monitoring fold-down", "",
+        juce::NormalisableRange<float> (0.0f, FoldDownPresets::numPresets - 1.0f, 1.0f), 0.0f,
+                                                   [](float value) { return FoldDownPresets::getPresetNames()[juce::roundToInt (value)]; },
+                                                   nullptr));
+
+    params.push_back (std::make_unique<Parameter> ("snapshot", "Snapshot", "",
+        juce::NormalisableRange<float> (0.0f, static_cast<float> (numSnapshots), 1.0f), 0.0f,
+                                                   [](float value) { return value < 0.5f ? juce::String ("-") : juce::String (juce::roundToInt (value)); },
+                                                   nullptr));
+
+    params.push_back (std::make_unique<Parameter> ("quantization", "Quantization", "",
+        juce::NormalisableRange<float> (0.0f, 3.0f, 1.0f), 0.0f,
+                                                   [](float value) { return juce::StringArray ({ "Off", "Beat", "Bar", "Grid" })[juce::roundToInt (value)]; },
+                                                   nullptr));
+
+    params.push_back (std::make_unique<Parameter> ("gridLength", "Grid length", "ms",
+        juce::NormalisableRange<float> (1.0f, 60000.0f, 1.0f, 0.3f), 1000.0f,
+                                                   [](float value) { return juce::String (value, 0); },
+                                                   nullptr));
+
+    params.push_back (std::make_unique<Parameter> ("autoCycle", "Auto-cycle", "",
+        juce::NormalisableRange<float> (0.0f, 3.0f, 1.0f), 0.0f,
+                                                   [](float value) { return juce::StringArray ({ "Off", "Sequential", "Random", "User order" })[juce::roundToInt (value)]; },
+                                                   nullptr));
+
+    params.push_back (std::make_unique<Parameter> ("cycleInterval", "Auto-cycle interval", "",
+        juce::NormalisableRange<float> (1.0f, 600.0f, 1.0f, 0.4f), 10.0f,
+                                                   [](float value) { return juce::String (value, 0); },
+                                                   nullptr));
+
+    params.push_back (std::make_unique<Parameter> ("cycleUnit", "Auto-cycle unit", "",
+        juce::NormalisableRange<float> (0.0f, 1.0f, 1.0f), 0.0f,
+                                                   [](float value) { return value < 0.5f ? "Seconds" : "Bars"; },
+                                                   nullptr));
+
+    // drives exclusive solo, so a switch is a single parameter change
+    params.push_back (std::make_unique<Parameter> ("selectedChoice", "Selected choice", "",
+        juce::NormalisableRange<float> (0.0f, maxNChoices - 1.0f, 1.0f), 0.0f,
+                                                   [](float value) { return getChoiceName (juce::roundToInt (value)); },
+                                                   nullptr));
+
+    params.push_back (std::make_unique<Parameter> ("difference", "Difference", "",
+        juce::NormalisableRange<float> (0.0f, 1.0f, 1.0f), 0.0f,
+                                                   [](float value) { return value >= 0.5f ? "ON" : "OFF"; },
+                                                   nullptr));
+
+    params.push_back (std::make_unique<Parameter> ("differenceA", "Difference A", "",
+        juce::NormalisableRange<float> (0.0f, maxNChoices - 1.0f, 1.0f), 0.0f,
+                                                   [](float value) { return getChoiceName (juce::roundToInt (value)); },
+                                                   nullptr));
+
+    params.push_back (std::make_unique<Parameter> ("differenceB", "Difference B", "",
+        juce::NormalisableRange<float> (0.0f, maxNChoices - 1.0f, 1.0f), 1.0f,
+                                                   [](float value) { return getChoiceName (juce::roundToInt (value)); },
+                                                   nullptr));
+
+    params.push_back (std::make_unique<Parameter> ("differenceGain", "Residual gain", "dB",
+        juce::NormalisableRange<float> (-20.0f, 60.0f, 0.1f), 0.0f,
+                                                   [](float value) { return juce::String (value, 1); },
+                                                   nullptr));
+
     return { params.begin(), params.end() };
 }
 //==============================================================================
@@ -360,6 +1385,51 @@ void AbcomparisonAudioProcessor::setEditorSize (int width, int height)
     parameters.state.setProperty (EditorHeight, height, nullptr);
 }
 
+bool AbcomparisonAudioProcessor::loadFile (const int choice, const juce::File& file)
+{
+    if (getFile (choice) == file)
+        return true;
+
+    auto player = std::make_unique<StreamingFilePlayer> (*readAheadThread);
+    if (! player->open (file, formatManager, maxChannelSize, juce::jmax (1, getBlockSize())))
+        return false;
+
+    // the files aren't resampled, so they'd play at the wrong speed; before prepareToPlay the rate isn't known yet,
+    // a file restored with the state is then checked by updateSources()
+    if (getSampleRate() > 0.0 && player->getFileSampleRate() != getSampleRate())
+        return false;
+
+    {
+        const juce::SpinLock::ScopedLockType lock (filePlayersLock);
+        std::swap (filePlayers[choice], player);
+        choiceHasFile[choice] = true;
+    }
+
+    return true;
+}
+
+void AbcomparisonAudioProcessor::unloadFile (const int choice)
+{
+    // destroyed after the lock is released, the audio thread doesn't use it anymore by then
+    std::unique_ptr<StreamingFilePlayer> player;
+    {
+        const juce::SpinLock::ScopedLockType lock (filePlayersLock);
+        std::swap (filePlayers[choice], player);
+        choiceHasFile[choice] = false;
+    }
+}
+
+bool AbcomparisonAudioProcessor::setFoldDownMatrix (const juce::String& matrix)
+{
+    return engine.getFoldDown().setUserMatrix (matrix);
+}
+
+juce::File AbcomparisonAudioProcessor::getFile (const int choice) const
+{
+    // only the message thread swaps the players, so reading them here is safe
+    return filePlayers[choice] != nullptr ? filePlayers[choice]->getFile() : juce::File();
+}
+
 // This creates new instances of the plugin..
 juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
 {
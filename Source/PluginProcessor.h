@@ -26,7 +26,12 @@
  */
 
 #pragma once
-#include "OSCReceiverPlus.h"
+#include "SharedOSCReceiver.h"
+#include "StreamingFilePlayer.h"
+#include "../Engine/SwitchEngine.h"
+#include "AnalyzerTap.h"
+#include "EventTracer.h"
+#include "RealtimeChecker.h"
 #include "../JuceLibraryCode/JuceHeader.h"
 
 //==============================================================================
@@ -35,18 +40,46 @@
 class AbcomparisonAudioProcessor :
     public juce::AudioProcessor,
     private juce::AudioProcessorValueTreeState::Listener,
-    private juce::OSCReceiver::ListenerWithOSCAddress<juce::OSCReceiver::MessageLoopCallback>
+    private SharedOSCReceiver::Client,
+    private juce::Timer
 {
     static const juce::Identifier EditorWidth;
     static const juce::Identifier EditorHeight;
     static const juce::Identifier OSCPort;
     static const juce::Identifier OSCEnabled;
+    static const juce::Identifier OSCName;
     static const juce::Identifier LabelText;
     static const juce::Identifier ButtonSize;
+    static const juce::Identifier AudioFiles;
+    static const juce::Identifier AudioFile;
+    static const juce::Identifier ChoiceIndex;
+    static const juce::Identifier FilePath;
+    static const juce::Identifier FoldDownUserMatrix;
+    static const juce::Identifier Snapshots;
+    static const juce::Identifier SnapshotState;
+    static const juce::Identifier SnapshotIndex;
+    static const juce::Identifier SnapshotChoices;
+    static const juce::Identifier SnapshotFadeTime;
+    static const juce::Identifier SnapshotToggleMode;
+    static const juce::Identifier SnapshotTrims;
+    static const juce::Identifier SnapshotInvertedChoices;
+    static const juce::Identifier CycleOrder;
+    static const juce::Identifier OSCOutTarget;
+    static const juce::Identifier ChoiceTrims;
+    static const juce::Identifier InvertedChoices;
+    static const juce::Identifier ChoiceDelays;
+    static const juce::Identifier NothingSelected;
     
 public:
     //==============================================================================
-    static constexpr int maxNChoices = 32;
+    static constexpr int maxNChoices = ABCOMPARISON_MAX_CHOICES;
+    static constexpr int maxChannelSize = ABCOMPARISON_MAX_CHANNELS;
+    static constexpr int maxEventsPerBlock = 128;
+    static constexpr int midiNoteOfFirstChoice = 36; // MIDI note 36 switches choice A, 37 choice B, ...
+    static constexpr int numSnapshots = 16; // MIDI program change 0 recalls the first one, 1 the second, ...
+
+    /** Fades, mixes and folds down the choices, the processor only tells it what to play. */
+    using Engine = SwitchEngine<maxNChoices, maxChannelSize>;
 
     //==============================================================================
     AbcomparisonAudioProcessor();
@@ -86,10 +119,21 @@ public:
     void setStateInformation (const void* data, int sizeInBytes) override;
 
     void parameterChanged (const juce::String &parameterID, float newValue) override;
-    void muteAllOtherChoices (const int choiceNotToMute);
+    void timerCallback() override;
 
     //==============================================================================
-    void oscMessageReceived (const juce::OSCMessage&) override;
+    bool isOSCEnabled() const override { return oscEnabled.load(); }
+    void setOSCEnabled (bool shouldBeEnabled);
+    void oscCommandReceived (const juce::String& command, const juce::OSCMessage&) override;
+    void oscSwitchMessageReceived (const juce::OSCMessage&);
+    void oscSnapshotMessageReceived (const juce::OSCMessage&);
+   #if ABCOMPARISON_TRACING
+    void oscTraceMessageReceived (const juce::OSCMessage&);
+   #endif
+
+    void setOSCName (const juce::String& newName);
+    const juce::String getOSCName() const { return sharedOSCReceiver->getClientName (this); }
+    int getOSCId() const noexcept { return oscId; }
 
 
     // === public flag for editor, signaling to resize window
@@ -97,7 +141,7 @@ public:
     std::atomic<bool> updateLabelText = false;
     std::atomic<bool> updateButtonSize = false;
     void setEditorSize (int width, int height);
-    std::atomic<int> editorWidth = 740;
+    std::atomic<int> editorWidth = 900;
     std::atomic<int> editorHeight = 300;
     std::atomic<bool> numberOfChoicesHasChanged = false;
 
@@ -107,21 +151,238 @@ public:
     void setButtonSize (int newSize);
     const int getButtonSize() { return buttonSize.get(); };
 
-    OSCReceiverPlus& getOSCReceiver() noexcept { return oscReceiver; }
+    OSCReceiverPlus& getOSCReceiver() noexcept { return sharedOSCReceiver->getReceiver(); }
+
+    //==============================================================================
+    /** A click on a choice: selects it in exclusive solo, toggles it in toggle mode. */
+    void switchChoice (const int choice);
+
+    /** Whether the parameters of the current mode have the choice playing. */
+    bool isChoiceOn (const int choice) const;
+
+    //==============================================================================
+    /** Lets a choice play an audio file instead of its input channels. Fails if the file can't be opened,
+        or if its sample rate differs from the host's; files aren't resampled. */
+    bool loadFile (const int choice, const juce::File& file);
+    void unloadFile (const int choice);
+    juce::File getFile (const int choice) const;
+    juce::String getAudioFileWildcard() const { return formatManager.getWildcardForAllFormats(); }
+
+    /** Sets the matrix of the user fold-down preset, one row per output channel, e.g. "0.5 0.5; 1 -1".
+        Returns false if the text couldn't be parsed. */
+    bool setFoldDownMatrix (const juce::String& matrix);
+    juce::String getFoldDownMatrix() const { return engine.getFoldDown().getUserMatrix(); }
+
+    /** Trim in dB, inverted polarity and delay in samples of the choices, see ChoiceAlignment.
+        The setters return false if the text couldn't be parsed. */
+    bool setChoiceTrims (const juce::String& trims) { return engine.getAlignment().setTrims (trims); }
+    bool setInvertedChoices (const juce::String& choices) { return engine.getAlignment().setInvertedChoices (choices); }
+    bool setChoiceDelays (const juce::String& delays) { return engine.getAlignment().setDelays (delays); }
+    juce::String getChoiceTrims() const { return engine.getAlignment().getTrims(); }
+    juce::String getInvertedChoices() const { return engine.getAlignment().getInvertedChoices(); }
+    juce::String getChoiceDelays() const { return engine.getAlignment().getDelays(); }
+
+    /** Stores the current switching state (choices, fade time, mode, trims and polarities) in a snapshot. */
+    void storeSnapshot (const int index);
+    void clearSnapshot (const int index);
+    bool isSnapshotStored (const int index) const { return snapshots[index].isStored; }
+
+    /** Recalls a snapshot at the start of the next audio block. */
+    void recallSnapshot (const int index);
+
+    /** Sets the order of the user-defined auto-cycle, e.g. "1 3 2", returns false if the text couldn't be parsed. */
+    bool setCycleOrder (const juce::String& order);
+    juce::String getCycleOrder() const;
+
+    /** The choice selected by the last auto-cycle step (-1 if it isn't cycling), and the seconds or bars until the next one. */
+    int getCycleChoice() const noexcept { return cycleChoice.load(); }
+    float getCycleRemaining() const noexcept { return cycleRemaining.load(); }
+
+    /** Sends every auto-cycle step as '/abc/<id>/cycle i' to "host:port", an empty target switches sending off. */
+    bool setOSCOutTarget (const juce::String& hostAndPort);
+    juce::String getOSCOutTarget() const { return oscOutTarget; }
+
+    /** Samples per tile of the mixer, 0 (the default) sizes the tiles for the cache. Only meant for benchmarks. */
+    void setMixTileLength (int numSamples) noexcept { engine.setMixTileLength (numSamples); }
+
+    /** The output and the reference choice for the editor's analyzer. */
+    AnalyzerTap& getAnalyzerTap() noexcept { return analyzerTap; }
+
+    /** False if none of the choice's channels carried a signal for a while. */
+    bool choiceHasSignal (const int choice) const noexcept { return engine.choiceHasSignal (choice); }
+
+    /** The name of a choice in the parameters and the editor: A to Z, then its number. */
+    static juce::String getChoiceName (int choice);
 
 private:
     juce::AudioProcessorValueTreeState parameters;
     juce::AudioProcessorValueTreeState::ParameterLayout createParameters();
-    juce::LinearSmoothedValue<float> gains[maxNChoices];
+    Engine engine;
+    float lastFadeTime = 0.0f;
+    void updateFadeLength (const float fadeTimeInMs);
+
+    /** A switch command at a sample position within the current block. */
+    struct SwitchEvent
+    {
+        enum Type { select, switchOn, switchOff, toggle, recallSnapshot };
+
+        int sampleOffset;
+        int choice; // the snapshot's index for recallSnapshot
+        Type type;
+        bool fromParameter;
+    };
+
+    SwitchEvent events[maxEventsPerBlock];
+    int numEvents = 0;
+    SwitchEvent carriedEvents[maxEventsPerBlock]; // didn't fit into their block, applied at the start of the next one
+    int numCarriedEvents = 0;
+    void addEvent (const SwitchEvent& newEvent);
+    void addCarriedEvents();
+    void applyEvent (const SwitchEvent& event);
+
+    // switching state, owned by the audio thread
+    bool lastChoiceStates[maxNChoices] = {};
+    int lastSelectedChoice = 0; // -1 while nothingSelected
+    bool wasExclusive = true;
+    std::atomic<bool> targetStates[maxNChoices] {};
+    std::atomic<bool> choiceStateNeedsSync[maxNChoices] {};
+    std::atomic<bool> parametersNeedSync = false;
+    std::atomic<bool> nothingSelected = false; // exclusive solo without a playing choice, as in sessions of older versions; ends with the next selection
+    int getSelectedChoice() const noexcept { return nothingSelected.load() ? -1 : juce::roundToInt (selectedChoice->load()); }
+    void setTargetState (const int choice, const bool state, const bool fromParameter);
+
+    /** The full switching state, preallocated, so the audio thread can recall it without touching the parameters. */
+    struct Snapshot
+    {
+        bool isStored = false;
+        bool choiceStates[maxNChoices] = {};
+        float fadeTime = 50.0f;
+        bool toggleMode = false;
+        bool hasTrims = false; // snapshots of older versions leave trims and polarities as they are
+        float trims[maxNChoices] = {};
+        bool invertedChoices[maxNChoices] = {};
+    };
+
+    Snapshot snapshots[numSnapshots];
+    juce::SpinLock snapshotsLock; // held by the message thread only while changing snapshots
+    std::atomic<int> pendingSnapshot = -1; // recall requested by the message thread
+    int snapshotToRetry = -1; // recall that found the snapshots locked, repeated at the start of the next block
+    int lastSnapshotParameter = 0; // the parameter recalls when its value changes, not when the same value is written again
+    std::atomic<int> recalledSnapshot = -1; // the parameters have to follow this recall
+    void applySnapshot (const int index);
+
+    // transport quantization: switches are deferred to the next beat, bar or grid line
+    enum QuantizationMode { quantizationOff, quantizeToBeat, quantizeToBar, quantizeToGrid };
+
+    struct QuantizationGrid
+    {
+        bool isActive = false;
+        bool transportJumped = false;
+        QuantizationMode mode = quantizationOff;
+        juce::int64 blockStart = 0;
+        int numSamples = 0;
+        juce::int64 gridLength = 1; // in samples
+        double samplesPerQuarter = 1.0;
+        double ppqAtBlockStart = 0.0;
+        double lastBarStart = 0.0;
+        double length = 1.0; // of a beat or bar, in quarter notes
+
+        /** The timeline position in samples of the first boundary at or after the offset within the block. */
+        juce::int64 getNextBoundary (int sampleOffset) const;
+    };
+
+    struct QuantizedEvent
+    {
+        juce::int64 time; // timeline position in samples
+        SwitchEvent event;
+    };
+
+    QuantizationGrid grid;
+    QuantizedEvent quantizedEvents[maxEventsPerBlock];
+    int numQuantizedEvents = 0;
+    void updateQuantizationGrid (const juce::Optional<juce::AudioPlayHead::PositionInfo>& position, int numSamples);
+    void scheduleEvent (const SwitchEvent& event);
+    void releaseQuantizedEvents (int numSamples);
+
+    // auto-cycle, runs on the audio thread against the sample clock or the host's bars
+    enum AutoCycleMode { autoCycleOff, cycleSequential, cycleRandom, cycleUserOrder };
+
+    int lastAutoCycleMode = autoCycleOff;
+    float lastCycleInterval = 0.0f;
+    juce::int64 cycleClock = 0; // samples since the cycle (re)started
+    juce::int64 cycleSteps = 0;
+    int barsSinceLastStep = 0;
+    juce::int64 lastBarIndex = 0; // of the last bar line counted, valid while hasLastBarIndex
+    bool hasLastBarIndex = false;
+    int cycleOrderIndex = -1;
+    juce::Random cycleRandom;
+    std::atomic<int> cycleChoice = -1;
+    std::atomic<int> cycleStepCount = 0;
+    std::atomic<float> cycleRemaining = 0.0f;
+    void scheduleAutoCycle (const juce::Optional<juce::AudioPlayHead::PositionInfo>& position, int nChoices, int numSamples);
+    void stepAutoCycle (int sampleOffset, int nChoices);
+
+    // user-defined cycle order, changed by the message thread and copied by the audio thread
+    int cycleOrder[maxNChoices] = {};
+    int cycleOrderLength = 0;
+    juce::String cycleOrderText;
+    mutable juce::SpinLock cycleOrderLock;
+    std::atomic<int> cycleOrderVersion = 0;
+    int activeCycleOrder[maxNChoices] = {};
+    int activeCycleOrderLength = 0;
+    int activeCycleOrderVersion = -1;
+
+    juce::OSCSender oscSender;
+    juce::String oscOutTarget;
+    int lastSentCycleStep = 0;
+
+    // points the engine to the channels each choice is read from
+    void updateSources (juce::AudioBuffer<float>& buffer, int stride, int nChoices, const juce::Optional<juce::AudioPlayHead::PositionInfo>& position,
+                        bool canReadFiles);
+
+    // first channel of each choice's side-chain input within the buffer, -1 if it's not connected
+    int sideChainFirstChannel[maxNChoices];
+    int sideChainNumChannels[maxNChoices] = {};
+    int mainBusNumInputChannels = 0;
+    static BusesProperties createBusesProperties();
+
+    AnalyzerTap analyzerTap;
+
+    juce::AudioFormatManager formatManager;
+    juce::SharedResourcePointer<ReadAheadThread> readAheadThread;
+    std::unique_ptr<StreamingFilePlayer> filePlayers[maxNChoices];
+    juce::SpinLock filePlayersLock; // held by the message thread while swapping players, by the audio thread while their output is mixed
+    std::atomic<bool> choiceHasFile[maxNChoices] {};
 
-    OSCReceiverPlus oscReceiver;
+    juce::SharedResourcePointer<SharedOSCReceiver> sharedOSCReceiver;
+    std::atomic<bool> oscEnabled = false;
+    int oscId;
 
     std::atomic<float>* numberOfChoices;
+    std::atomic<float>* channelSize;
     std::atomic<float>* switchMode;
     std::atomic<float>* fadeTime;
+    std::atomic<float>* zeroCrossingSwitch;
+    std::atomic<float>* foldDownPreset;
+    std::atomic<float>* snapshotParameter;
+    std::atomic<float>* quantization;
+    std::atomic<float>* gridLength;
+    std::atomic<float>* autoCycle;
+    std::atomic<float>* cycleInterval;
+    std::atomic<float>* cycleUnit;
+    std::atomic<float>* selectedChoice;
+    std::atomic<float>* differenceMode;
+    std::atomic<float>* differenceA;
+    std::atomic<float>* differenceB;
+    std::atomic<float>* differenceGain;
     std::atomic<float>* choiceStates[maxNChoices];
 
-    bool mutingOtherChoices = false;
+    // the parameters the processor sets itself, looked up once instead of by their IDs
+    juce::RangedAudioParameter* switchModeParameter;
+    juce::RangedAudioParameter* fadeTimeParameter;
+    juce::RangedAudioParameter* snapshotRecallParameter;
+    juce::RangedAudioParameter* selectedChoiceParameter;
+    juce::RangedAudioParameter* choiceStateParameters[maxNChoices];
 
     juce::String labelText = "";
     juce::Atomic<int> buttonSize = 120;
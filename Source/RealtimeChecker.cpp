@@ -0,0 +1,201 @@
+/*
+==============================================================================
+
+ABComparison Plug-in
+Copyright (C) 2018 - Daniel Rudrich
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+==============================================================================
+*/
+
+#include "RealtimeChecker.h"
+
+#if ABCOMPARISON_REALTIME_CHECKS
+
+#include <cerrno>
+#include <iostream>
+#include <new>
+
+#if defined (__GLIBC__)
+ #include <dlfcn.h>
+ #include <pthread.h>
+#endif
+
+namespace RealtimeChecker
+{
+    // plain thread-locals, they are set up with the thread and never allocate
+    static thread_local const char* scopeName = nullptr;
+    static thread_local int numSuspended = 0;
+
+    static std::atomic<int> numViolations { 0 };
+    static std::atomic<int> maxNumReports { 10 };
+
+    int getNumViolations() noexcept { return numViolations.load(); }
+    void resetViolations() noexcept { numViolations = 0; }
+    void setMaxReports (int maxReports) noexcept { maxNumReports = maxReports; }
+
+    ScopedRealtime::ScopedRealtime (const char* name) noexcept : previousName (scopeName) { scopeName = name; }
+    ScopedRealtime::~ScopedRealtime() noexcept { scopeName = previousName; }
+
+    ScopedNonRealtime::ScopedNonRealtime() noexcept { ++numSuspended; }
+    ScopedNonRealtime::~ScopedNonRealtime() noexcept { --numSuspended; }
+
+    /** Called by the replacements before they allocate, free or lock. */
+    static void check (const char* function, size_t size = 0) noexcept
+    {
+        if (scopeName == nullptr || numSuspended > 0)
+            return;
+
+        const int violation = numViolations++;
+        if (violation >= maxNumReports.load())
+            return;
+
+        // reporting allocates, so the checks are off meanwhile
+        const ScopedNonRealtime nonRealtime;
+        std::cerr << "Real-time violation #" << violation + 1 << ": " << function;
+        if (size > 0)
+            std::cerr << " (" << size << " bytes)";
+
+        std::cerr << " in " << scopeName << std::endl
+                  << juce::SystemStats::getStackBacktrace() << std::endl;
+    }
+}
+
+//==============================================================================
+#if defined (__GLIBC__)
+
+// glibc: the C allocation functions are replaced, operator new and delete use them,
+// and so do std::mutex and juce::CriticalSection with pthread_mutex_lock
+extern "C"
+{
+    void* __libc_malloc (size_t);
+    void* __libc_calloc (size_t, size_t);
+    void* __libc_realloc (void*, size_t);
+    void* __libc_memalign (size_t, size_t);
+    void __libc_free (void*);
+
+    void* malloc (size_t size)
+    {
+        RealtimeChecker::check ("malloc", size);
+        return __libc_malloc (size);
+    }
+
+    void* calloc (size_t count, size_t size)
+    {
+        RealtimeChecker::check ("calloc", count * size);
+        return __libc_calloc (count, size);
+    }
+
+    void* realloc (void* pointer, size_t size)
+    {
+        RealtimeChecker::check ("realloc", size);
+        return __libc_realloc (pointer, size);
+    }
+
+    void* memalign (size_t alignment, size_t size)
+    {
+        RealtimeChecker::check ("memalign", size);
+        return __libc_memalign (alignment, size);
+    }
+
+    void* aligned_alloc (size_t alignment, size_t size)
+    {
+        RealtimeChecker::check ("aligned_alloc", size);
+        return __libc_memalign (alignment, size);
+    }
+
+    int posix_memalign (void** pointer, size_t alignment, size_t size)
+    {
+        RealtimeChecker::check ("posix_memalign", size);
+        if (alignment % sizeof (void*) != 0 || (alignment & (alignment - 1)) != 0)
+            return EINVAL;
+
+        *pointer = __libc_memalign (alignment, size);
+        return *pointer != nullptr ? 0 : ENOMEM;
+    }
+
+    void free (void* pointer)
+    {
+        if (pointer != nullptr)
+            RealtimeChecker::check ("free");
+
+        __libc_free (pointer);
+    }
+
+    int pthread_mutex_lock (pthread_mutex_t* mutex)
+    {
+        RealtimeChecker::check ("pthread_mutex_lock");
+
+        // looked up on first use, locks might be taken before the static initialisers run
+        using LockFunction = int (*) (pthread_mutex_t*);
+        static std::atomic<LockFunction> lock { nullptr };
+
+        auto function = lock.load (std::memory_order_relaxed);
+        if (function == nullptr)
+        {
+            function = reinterpret_cast<LockFunction> (dlsym (RTLD_NEXT, "pthread_mutex_lock"));
+            lock.store (function, std::memory_order_relaxed);
+        }
+
+        return function (mutex);
+    }
+}
+
+#else
+
+// elsewhere, only operator new and delete are replaced
+static void* allocate (size_t size, const char* function)
+{
+    RealtimeChecker::check (function, size);
+    return std::malloc (size > 0 ? size : 1);
+}
+
+static void deallocate (void* pointer, const char* function) noexcept
+{
+    if (pointer != nullptr)
+        RealtimeChecker::check (function);
+
+    std::free (pointer);
+}
+
+void* operator new (size_t size)
+{
+    if (auto* pointer = allocate (size, "operator new"))
+        return pointer;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[] (size_t size)
+{
+    if (auto* pointer = allocate (size, "operator new[]"))
+        return pointer;
+
+    throw std::bad_alloc();
+}
+
+void* operator new (size_t size, const std::nothrow_t&) noexcept    { return allocate (size, "operator new"); }
+void* operator new[] (size_t size, const std::nothrow_t&) noexcept  { return allocate (size, "operator new[]"); }
+
+void operator delete (void* pointer) noexcept                              { deallocate (pointer, "operator delete"); }
+void operator delete[] (void* pointer) noexcept                            { deallocate (pointer, "operator delete[]"); }
+void operator delete (void* pointer, size_t) noexcept                      { deallocate (pointer, "operator delete"); }
+void operator delete[] (void* pointer, size_t) noexcept                    { deallocate (pointer, "operator delete[]"); }
+void operator delete (void* pointer, const std::nothrow_t&) noexcept       { deallocate (pointer, "operator delete"); }
+void operator delete[] (void* pointer, const std::nothrow_t&) noexcept     { deallocate (pointer, "operator delete[]"); }
+
+#endif
+
+#endif
@@ -0,0 +1,88 @@
+/*
+==============================================================================
+
+ABComparison Plug-in
+Copyright (C) 2018 - Daniel Rudrich
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+==============================================================================
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+/*
+ ===== Real-time safety checks =====
+ Compiled in with ABCOMPARISON_REALTIME_CHECKS=1 (CMake option ABCOMPARISON_ENABLE_REALTIME_CHECKS),
+ which also links RealtimeChecker.cpp, the replacements of the allocation and locking functions.
+ Otherwise, the macro below compiles to nothing.
+
+    ABC_REALTIME_SCOPE ("processBlock");    from here to the end of the scope, this thread must not allocate, free or lock
+
+ Within such a scope, every heap allocation or deallocation and every mutex lock is a violation,
+ which is counted and reported with its call stack on stderr. With glibc, malloc, free and the other
+ C allocation functions are replaced, which also catches operator new and delete, as they use them,
+ and so is pthread_mutex_lock, which catches the locks of juce::CriticalSection and std::mutex.
+ Elsewhere, only operator new and delete are replaced, so C allocations and locks aren't caught.
+ Only meant for debug and test builds, the checks themselves aren't real-time safe.
+ */
+#ifndef ABCOMPARISON_REALTIME_CHECKS
+ #define ABCOMPARISON_REALTIME_CHECKS 0
+#endif
+
+#if ABCOMPARISON_REALTIME_CHECKS
+
+namespace RealtimeChecker
+{
+    /** Violations on any thread since the start, or the last reset. */
+    int getNumViolations() noexcept;
+    void resetViolations() noexcept;
+
+    /** Stops reporting the call stacks after this many violations, they're still counted. */
+    void setMaxReports (int maxReports) noexcept;
+
+    /** Marks the calling thread as real-time, scopes can be nested. The name has to be a string literal,
+        the reports name the innermost scope. */
+    class ScopedRealtime
+    {
+    public:
+        explicit ScopedRealtime (const char* name) noexcept;
+        ~ScopedRealtime() noexcept;
+
+    private:
+        const char* const previousName;
+
+        JUCE_DECLARE_NON_COPYABLE (ScopedRealtime)
+    };
+
+    /** Allows allocations and locks within a real-time scope, e.g. for the checks' own reports. */
+    class ScopedNonRealtime
+    {
+    public:
+        ScopedNonRealtime() noexcept;
+        ~ScopedNonRealtime() noexcept;
+
+        JUCE_DECLARE_NON_COPYABLE (ScopedNonRealtime)
+    };
+}
+
+ #define ABC_REALTIME_SCOPE(name)    const RealtimeChecker::ScopedRealtime JUCE_JOIN_MACRO (realtimeScope_, __LINE__) (name)
+
+#else
+
+ #define ABC_REALTIME_SCOPE(name)
+
+#endif
@@ -30,7 +30,7 @@
 class SettingsComponent : public juce::Component
 {
 public:
-    SettingsComponent (AbcomparisonAudioProcessor& p) : processor (p)
+    SettingsComponent (AbcomparisonAudioProcessor& p, juce::AudioProcessorValueTreeState& vts) : processor (p)
     {
         addAndMakeVisible (editor);
         editor.setMultiLine (true);
@@ -42,6 +42,137 @@ public:
         size.setRange (50, 240, 1);
         size.setValue (processor.getButtonSize());
         size.onValueChange = [this] () { setButtonSize(); };
+
+        addAndMakeVisible (oscNameLabel);
+        oscNameLabel.setText ("OSC name", juce::dontSendNotification);
+
+        addAndMakeVisible (oscName);
+        oscName.setMultiLine (false);
+        oscName.setTextToShowWhenEmpty ("/abc/" + juce::String (processor.getOSCId()) + "/switch", juce::Colours::grey);
+        oscName.setTooltip ("This instance also listens to '/abc/<name>/switch i'.");
+        oscName.setText (processor.getOSCName());
+        oscName.onTextChange = [this] () { setOSCName(); };
+
+        addAndMakeVisible (autoCycleLabel);
+        autoCycleLabel.setText ("Auto-cycle", juce::dontSendNotification);
+
+        addAndMakeVisible (autoCycle);
+        autoCycle.addItemList ({ "Off", "Sequential", "Random", "User order" }, 1);
+        autoCycle.setTooltip ("Steps through the choices automatically");
+        autoCycleAttachment.reset (new juce::AudioProcessorValueTreeState::ComboBoxAttachment (vts, "autoCycle", autoCycle));
+
+        addAndMakeVisible (cycleUnit);
+        cycleUnit.addItemList ({ "Seconds", "Bars" }, 1);
+        cycleUnitAttachment.reset (new juce::AudioProcessorValueTreeState::ComboBoxAttachment (vts, "cycleUnit", cycleUnit));
+
+        addAndMakeVisible (cycleIntervalLabel);
+        cycleIntervalLabel.setText ("Every", juce::dontSendNotification);
+
+        addAndMakeVisible (cycleInterval);
+        cycleInterval.setTextBoxStyle (juce::Slider::TextBoxRight, false, 80, 20);
+        cycleInterval.setTooltip ("Seconds or bars between two auto-cycle steps");
+        cycleIntervalAttachment.reset (new juce::AudioProcessorValueTreeState::SliderAttachment (vts, "cycleInterval", cycleInterval));
+
+        addAndMakeVisible (cycleOrderLabel);
+        cycleOrderLabel.setText ("Order", juce::dontSendNotification);
+
+        addAndMakeVisible (cycleOrder);
+        cycleOrder.setMultiLine (false);
+        cycleOrder.setTextToShowWhenEmpty ("user order, e.g. 1 3 2 3", juce::Colours::grey);
+        cycleOrder.setText (processor.getCycleOrder());
+        cycleOrder.onTextChange = [this] () { setCycleOrder(); };
+
+        addAndMakeVisible (oscOutLabel);
+        oscOutLabel.setText ("OSC out", juce::dontSendNotification);
+
+        addAndMakeVisible (oscOut);
+        oscOut.setMultiLine (false);
+        oscOut.setTextToShowWhenEmpty ("host:port", juce::Colours::grey);
+        oscOut.setTooltip ("Every auto-cycle step is sent as '/abc/" + juce::String (processor.getOSCId()) + "/cycle i' to this address");
+        oscOut.setText (processor.getOSCOutTarget());
+        oscOut.onReturnKey = [this] () { setOSCOutTarget(); };
+        oscOut.onFocusLost = [this] () { setOSCOutTarget(); };
+
+        addAndMakeVisible (gridLengthLabel);
+        gridLengthLabel.setText ("Grid", juce::dontSendNotification);
+
+        addAndMakeVisible (gridLength);
+        gridLength.setTextBoxStyle (juce::Slider::TextBoxRight, false, 80, 20);
+        gridLength.setTextValueSuffix (" ms");
+        gridLength.setTooltip ("The grid length for quantized switching, the grid starts at the beginning of the timeline");
+        gridLengthAttachment.reset (new juce::AudioProcessorValueTreeState::SliderAttachment (vts, "gridLength", gridLength));
+
+        addAndMakeVisible (foldDownLabel);
+        foldDownLabel.setText ("Fold-down", juce::dontSendNotification);
+
+        addAndMakeVisible (foldDown);
+        foldDown.addItemList (FoldDownPresets::getPresetNames(), 1);
+        foldDown.setTooltip ("Folds the output down to the monitoring layout. The presets expect L R C LFE Ls Rs [Lb Rb] [Ltf Rtf Ltb Rtb].");
+        foldDownAttachment.reset (new juce::AudioProcessorValueTreeState::ComboBoxAttachment (vts, "foldDown", foldDown));
+
+        addAndMakeVisible (foldDownMatrix);
+        foldDownMatrix.setMultiLine (false);
+        foldDownMatrix.setTextToShowWhenEmpty ("user matrix, e.g. 1 0 0.7; 0 1 0.7", juce::Colours::grey);
+        foldDownMatrix.setTooltip ("One row per output channel, separated by ';', with one coefficient per input channel.");
+        foldDownMatrix.setText (processor.getFoldDownMatrix());
+        foldDownMatrix.onTextChange = [this] () { setFoldDownMatrix(); };
+
+        addAndMakeVisible (trimsLabel);
+        trimsLabel.setText ("Trim", juce::dontSendNotification);
+
+        addAndMakeVisible (trims);
+        trims.setMultiLine (false);
+        trims.setTextToShowWhenEmpty ("dB per choice, e.g. 0 -1.5 0.3", juce::Colours::grey);
+        trims.setText (processor.getChoiceTrims());
+        trims.onTextChange = [this] () { showValidity (trims, processor.setChoiceTrims (trims.getText())); };
+
+        addAndMakeVisible (invertedLabel);
+        invertedLabel.setText ("Invert", juce::dontSendNotification);
+
+        addAndMakeVisible (inverted);
+        inverted.setMultiLine (false);
+        inverted.setTextToShowWhenEmpty ("choices with inverted polarity, e.g. 2 4", juce::Colours::grey);
+        inverted.setText (processor.getInvertedChoices());
+        inverted.onTextChange = [this] () { showValidity (inverted, processor.setInvertedChoices (inverted.getText())); };
+
+        addAndMakeVisible (delaysLabel);
+        delaysLabel.setText ("Delay", juce::dontSendNotification);
+
+        addAndMakeVisible (delays);
+        delays.setMultiLine (false);
+        delays.setTextToShowWhenEmpty ("samples per choice, e.g. 0 0 128", juce::Colours::grey);
+        delays.setTooltip ("Up to " + juce::String (AbcomparisonAudioProcessor::Engine::Alignment::maxDelay) + " samples");
+        delays.setText (processor.getChoiceDelays());
+        delays.onTextChange = [this] () { showValidity (delays, processor.setChoiceDelays (delays.getText())); };
+
+        addAndMakeVisible (difference);
+        difference.setButtonText ("A - B");
+        difference.setTooltip ("Plays the difference between two choices, after their trim, polarity and delay. With the same choice twice, the mix plays");
+        differenceAttachment.reset (new juce::AudioProcessorValueTreeState::ButtonAttachment (vts, "difference", difference));
+
+        for (auto* choice : { &differenceA, &differenceB })
+        {
+            addAndMakeVisible (choice);
+            for (int i = 0; i < AbcomparisonAudioProcessor::maxNChoices; ++i)
+                choice->addItem (juce::String (i + 1), i + 1);
+        }
+
+        differenceAAttachment.reset (new juce::AudioProcessorValueTreeState::ComboBoxAttachment (vts, "differenceA", differenceA));
+        differenceBAttachment.reset (new juce::AudioProcessorValueTreeState::ComboBoxAttachment (vts, "differenceB", differenceB));
+
+        // a choice can't be compared with itself
+        differenceA.onChange = [this] () { updateDifferenceItems(); };
+        differenceB.onChange = [this] () { updateDifferenceItems(); };
+        updateDifferenceItems();
+
+        addAndMakeVisible (residualLabel);
+        residualLabel.setText ("Residual", juce::dontSendNotification);
+
+        addAndMakeVisible (residualGain);
+        residualGain.setTextBoxStyle (juce::Slider::TextBoxRight, false, 80, 20);
+        residualGain.setTextValueSuffix (" dB");
+        residualGain.setTooltip ("Gain of the difference, to make small residuals audible");
+        residualGainAttachment.reset (new juce::AudioProcessorValueTreeState::SliderAttachment (vts, "differenceGain", residualGain));
     }
 
     ~SettingsComponent()
@@ -62,12 +193,128 @@ public:
         processor.setButtonSize (size.getValue());
     }
 
+    void setOSCName()
+    {
+        processor.setOSCName (oscName.getText());
+    }
+
+    void setCycleOrder()
+    {
+        showValidity (cycleOrder, processor.setCycleOrder (cycleOrder.getText()));
+    }
+
+    void setOSCOutTarget()
+    {
+        if (oscOut.getText().trim() != processor.getOSCOutTarget())
+            showValidity (oscOut, processor.setOSCOutTarget (oscOut.getText()));
+    }
+
+    void showValidity (juce::TextEditor& textEditor, bool isValid)
+    {
+        textEditor.setColour (juce::TextEditor::outlineColourId, isValid ? getLookAndFeel().findColour (juce::TextEditor::outlineColourId) : juce::Colours::red);
+        textEditor.repaint();
+    }
+
+    void updateDifferenceItems()
+    {
+        for (int id = 1; id <= AbcomparisonAudioProcessor::maxNChoices; ++id)
+        {
+            differenceA.setItemEnabled (id, id != differenceB.getSelectedId());
+            differenceB.setItemEnabled (id, id != differenceA.getSelectedId());
+        }
+    }
+
+    void setFoldDownMatrix()
+    {
+        showValidity (foldDownMatrix, processor.setFoldDownMatrix (foldDownMatrix.getText()));
+    }
+
     void resized() override
     {
         auto bounds = getLocalBounds();
         bounds.removeFromTop (2);
 
         auto row = bounds.removeFromBottom (25);
+        residualLabel.setBounds (row.removeFromLeft (70));
+        residualGain.setBounds (row);
+
+        bounds.removeFromBottom (4);
+
+        row = bounds.removeFromBottom (25);
+        difference.setBounds (row.removeFromLeft (70));
+        differenceA.setBounds (row.removeFromLeft (row.getWidth() / 2 - 2));
+        differenceB.setBounds (row.removeFromRight (row.getWidth() - 4));
+
+        bounds.removeFromBottom (4);
+
+        row = bounds.removeFromBottom (25);
+        delaysLabel.setBounds (row.removeFromLeft (70));
+        delays.setBounds (row);
+
+        bounds.removeFromBottom (4);
+
+        row = bounds.removeFromBottom (25);
+        invertedLabel.setBounds (row.removeFromLeft (70));
+        inverted.setBounds (row);
+
+        bounds.removeFromBottom (4);
+
+        row = bounds.removeFromBottom (25);
+        trimsLabel.setBounds (row.removeFromLeft (70));
+        trims.setBounds (row);
+
+        bounds.removeFromBottom (4);
+
+        row = bounds.removeFromBottom (25);
+        foldDownMatrix.setBounds (row);
+
+        bounds.removeFromBottom (4);
+
+        row = bounds.removeFromBottom (25);
+        foldDownLabel.setBounds (row.removeFromLeft (70));
+        foldDown.setBounds (row);
+
+        bounds.removeFromBottom (4);
+
+        row = bounds.removeFromBottom (25);
+        oscOutLabel.setBounds (row.removeFromLeft (70));
+        oscOut.setBounds (row);
+
+        bounds.removeFromBottom (4);
+
+        row = bounds.removeFromBottom (25);
+        cycleOrderLabel.setBounds (row.removeFromLeft (70));
+        cycleOrder.setBounds (row);
+
+        bounds.removeFromBottom (4);
+
+        row = bounds.removeFromBottom (25);
+        cycleIntervalLabel.setBounds (row.removeFromLeft (70));
+        cycleInterval.setBounds (row);
+
+        bounds.removeFromBottom (4);
+
+        row = bounds.removeFromBottom (25);
+        autoCycleLabel.setBounds (row.removeFromLeft (70));
+        cycleUnit.setBounds (row.removeFromRight (80));
+        row.removeFromRight (4);
+        autoCycle.setBounds (row);
+
+        bounds.removeFromBottom (4);
+
+        row = bounds.removeFromBottom (25);
+        gridLengthLabel.setBounds (row.removeFromLeft (70));
+        gridLength.setBounds (row);
+
+        bounds.removeFromBottom (4);
+
+        row = bounds.removeFromBottom (25);
+        oscNameLabel.setBounds (row.removeFromLeft (70));
+        oscName.setBounds (row);
+
+        bounds.removeFromBottom (4);
+
+        row = bounds.removeFromBottom (25);
         size.setBounds (row);
 
         bounds.removeFromBottom (4);
@@ -80,6 +327,35 @@ private:
 
     juce::TextEditor editor;
     juce::Slider size;
+    juce::Label oscNameLabel;
+    juce::TextEditor oscName;
+    juce::Label autoCycleLabel;
+    juce::ComboBox autoCycle;
+    juce::ComboBox cycleUnit;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> autoCycleAttachment, cycleUnitAttachment;
+    juce::Label cycleIntervalLabel;
+    juce::Slider cycleInterval;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> cycleIntervalAttachment;
+    juce::Label cycleOrderLabel;
+    juce::TextEditor cycleOrder;
+    juce::Label oscOutLabel;
+    juce::TextEditor oscOut;
+    juce::Label gridLengthLabel;
+    juce::Slider gridLength;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> gridLengthAttachment;
+    juce::Label foldDownLabel;
+    juce::ComboBox foldDown;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> foldDownAttachment;
+    juce::TextEditor foldDownMatrix;
+    juce::Label trimsLabel, invertedLabel, delaysLabel;
+    juce::TextEditor trims, inverted, delays;
+    juce::ToggleButton difference;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> differenceAttachment;
+    juce::ComboBox differenceA, differenceB;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> differenceAAttachment, differenceBAttachment;
+    juce::Label residualLabel;
+    juce::Slider residualGain;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> residualGainAttachment;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SettingsComponent)
 };
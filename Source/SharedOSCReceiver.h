@@ -0,0 +1,184 @@
+/*
+==============================================================================
+
+ABComparison Plug-in
+Copyright (C) 2018 - Daniel Rudrich
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+==============================================================================
+*/
+
+#pragma once
+
+#include "OSCReceiverPlus.h"
+#include "EventTracer.h"
+#include "../JuceLibraryCode/JuceHeader.h"
+
+/** A process-wide OSC endpoint, shared by all plug-in instances.
+
+    Hold it via juce::SharedResourcePointer<SharedOSCReceiver>: there is only one socket and one
+    receiver thread per process, which are released together with the last instance.
+    The socket is open as long as at least one registered client has OSC enabled.
+
+    Incoming messages are routed to the clients by their address, the last part of the address is
+    the command (e.g. `switch` or `snapshot`), which is passed on to the clients:
+     - `/<command> ...`            every client
+     - `/abc/<name>/<command> ...` the clients with that instance name
+     - `/abc/<id>/<command> ...`   the client with that instance id
+*/
+class SharedOSCReceiver : private juce::OSCReceiver::Listener<juce::OSCReceiver::MessageLoopCallback>
+{
+public:
+    class Client
+    {
+    public:
+        virtual ~Client() = default;
+
+        virtual bool isOSCEnabled() const = 0;
+        virtual void oscCommandReceived (const juce::String& command, const juce::OSCMessage&) = 0;
+    };
+
+    SharedOSCReceiver() : receiver (9222)
+    {
+        receiver.addListener (this);
+    }
+
+    ~SharedOSCReceiver() override
+    {
+        receiver.removeListener (this);
+        receiver.disconnect();
+    }
+
+    /** Registers a client and returns its instance id, which is the lowest free id starting at 1. */
+    int addClient (Client* client)
+    {
+        const juce::ScopedLock sl (lock);
+
+        int id = 1;
+        while (findRegistration (id) != nullptr)
+            ++id;
+
+        registrations.add ({ client, id, {} });
+        return id;
+    }
+
+    void removeClient (Client* client)
+    {
+        {
+            const juce::ScopedLock sl (lock);
+            registrations.removeIf ([client] (const Registration& r) { return r.client == client; });
+        }
+
+        updateConnection();
+    }
+
+    /** Sets the name under which a client is reachable. Characters not allowed in OSC addresses are removed. */
+    void setClientName (Client* client, const juce::String& name)
+    {
+        const juce::ScopedLock sl (lock);
+
+        for (auto& r : registrations)
+            if (r.client == client)
+                r.name = sanitiseName (name);
+    }
+
+    juce::String getClientName (const Client* client) const
+    {
+        const juce::ScopedLock sl (lock);
+
+        for (auto& r : registrations)
+            if (r.client == client)
+                return r.name;
+
+        return {};
+    }
+
+    /** Opens the socket if any client wants to receive OSC, closes it otherwise. */
+    void updateConnection()
+    {
+        bool anyEnabled = false;
+        {
+            const juce::ScopedLock sl (lock);
+            for (auto& r : registrations)
+                anyEnabled = anyEnabled || r.client->isOSCEnabled();
+        }
+
+        receiver.setAutoConnect (anyEnabled);
+        if (! anyEnabled)
+            receiver.disconnect();
+    }
+
+    OSCReceiverPlus& getReceiver() noexcept { return receiver; }
+
+    static juce::String sanitiseName (const juce::String& name)
+    {
+        return name.trim().removeCharacters (" #*,/?[]{}");
+    }
+
+private:
+    struct Registration
+    {
+        Client* client;
+        int id;
+        juce::String name;
+    };
+
+    const Registration* findRegistration (int id) const
+    {
+        for (auto& r : registrations)
+            if (r.id == id)
+                return &r;
+
+        return nullptr;
+    }
+
+    void oscMessageReceived (const juce::OSCMessage& message) override
+    {
+        ABC_TRACE_THREAD ("message");
+        ABC_TRACE_SCOPE ("oscReceive");
+
+        auto tokens = juce::StringArray::fromTokens (message.getAddressPattern().toString(), "/", "");
+        tokens.removeEmptyStrings();
+
+        const juce::ScopedLock sl (lock);
+
+        if (tokens.size() == 1)
+        {
+            for (auto& r : registrations)
+                if (r.client->isOSCEnabled())
+                    r.client->oscCommandReceived (tokens[0], message);
+
+            return;
+        }
+
+        if (tokens.size() != 3 || tokens[0] != "abc")
+            return;
+
+        const auto& target = tokens[1];
+        const bool targetIsId = target.containsOnly ("0123456789");
+        const int targetId = target.getIntValue();
+
+        for (auto& r : registrations)
+            if (r.client->isOSCEnabled() && (targetIsId ? r.id == targetId : r.name == target))
+                r.client->oscCommandReceived (tokens[2], message);
+    }
+
+    OSCReceiverPlus receiver;
+
+    juce::CriticalSection lock;
+    juce::Array<Registration> registrations;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SharedOSCReceiver)
+};
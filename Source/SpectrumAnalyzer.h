@@ -0,0 +1,247 @@
+/*
+==============================================================================
+
+ABComparison Plug-in
+Copyright (C) 2018 - Daniel Rudrich
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+==============================================================================
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "AnalyzerTap.h"
+
+/** Shows the averaged spectra of the output and a reference choice, or their difference.
+
+    The FFTs and the averaging run on a background thread, which reads from the AnalyzerTap and
+    hands a decimated, log-spaced spectrum to the message thread. Nothing runs while the analyzer
+    is stopped, and the destructor stops it, so closing the editor stops all analysis work.
+*/
+class SpectrumAnalyzer : public juce::Component,
+                         private juce::Thread,
+                         private juce::Timer
+{
+public:
+    enum Mode { spectra, difference };
+
+    static constexpr int fftOrder = 12;
+    static constexpr int fftSize = 1 << fftOrder;
+    static constexpr int hopSize = fftSize / 4;
+    static constexpr int numPoints = 256; // displayed, log-spaced from 20Hz to 20kHz
+    static constexpr float averaging = 0.2f; // weight of a new frame
+
+    SpectrumAnalyzer (AnalyzerTap& tapToUse)
+        : juce::Thread ("ABComparison analyzer"), tap (tapToUse),
+          fft (fftOrder), window (fftSize, juce::dsp::WindowingFunction<float>::hann, false)
+    {
+        setOpaque (true);
+        std::fill (&displayed[0][0], &displayed[0][0] + 2 * numPoints, -200.0f);
+    }
+
+    ~SpectrumAnalyzer() override
+    {
+        stop();
+    }
+
+    void start()
+    {
+        tap.setActive (true);
+        startThread (juce::Thread::Priority::low);
+        startTimerHz (30);
+    }
+
+    void stop()
+    {
+        stopTimer();
+        tap.setActive (false);
+        stopThread (1000);
+    }
+
+    void setMode (Mode newMode)
+    {
+        mode = newMode;
+        repaint();
+    }
+
+    //==============================================================================
+    void paint (juce::Graphics& g) override
+    {
+        auto bounds = getLocalBounds().toFloat();
+        g.fillAll (juce::Colour (0xff16191c));
+
+        const float minDecibels = mode == spectra ? -100.0f : -24.0f;
+        const float maxDecibels = mode == spectra ? 0.0f : 24.0f;
+        auto decibelsToY = [&] (float decibels)
+        {
+            return juce::jmap (juce::jlimit (minDecibels, maxDecibels, decibels), minDecibels, maxDecibels, bounds.getBottom(), bounds.getY());
+        };
+
+        // grid, every decade and every 20dB (6dB for the difference)
+        g.setFont (10.0f);
+        for (float frequency : { 100.0f, 1000.0f, 10000.0f })
+        {
+            const float x = bounds.getX() + bounds.getWidth() * std::log (frequency / minFrequency) / std::log (maxFrequency / minFrequency);
+            g.setColour (juce::Colours::white.withAlpha (0.15f));
+            g.drawVerticalLine (juce::roundToInt (x), bounds.getY(), bounds.getBottom());
+            g.setColour (juce::Colours::white.withAlpha (0.5f));
+            g.drawText (frequency < 1000.0f ? juce::String (frequency, 0) : juce::String (frequency / 1000.0f, 0) + "k",
+                        juce::Rectangle<float> (x + 2.0f, bounds.getBottom() - 14.0f, 30.0f, 12.0f), juce::Justification::left);
+        }
+
+        const float gridStep = mode == spectra ? 20.0f : 6.0f;
+        for (float decibels = minDecibels + gridStep; decibels < maxDecibels; decibels += gridStep)
+        {
+            g.setColour (juce::Colours::white.withAlpha (decibels == 0.0f ? 0.4f : 0.15f));
+            g.drawHorizontalLine (juce::roundToInt (decibelsToY (decibels)), bounds.getX(), bounds.getRight());
+            g.setColour (juce::Colours::white.withAlpha (0.5f));
+            g.drawText (juce::String (decibels, 0) + " dB", juce::Rectangle<float> (bounds.getX() + 2.0f, decibelsToY (decibels) - 12.0f, 50.0f, 12.0f), juce::Justification::left);
+        }
+
+        auto drawCurve = [&] (juce::Colour colour, auto getDecibels)
+        {
+            juce::Path path;
+            for (int i = 0; i < numPoints; ++i)
+            {
+                const float x = bounds.getX() + bounds.getWidth() * i / (numPoints - 1.0f);
+                const float y = decibelsToY (getDecibels (i));
+                if (i == 0)
+                    path.startNewSubPath (x, y);
+                else
+                    path.lineTo (x, y);
+            }
+
+            g.setColour (colour);
+            g.strokePath (path, juce::PathStrokeType (1.5f));
+        };
+
+        if (mode == spectra)
+        {
+            drawCurve (juce::Colours::orange, [this] (int i) { return displayed[AnalyzerTap::reference][i]; });
+            drawCurve (juce::Colours::limegreen, [this] (int i) { return displayed[AnalyzerTap::output][i]; });
+        }
+        else
+        {
+            drawCurve (juce::Colours::limegreen, [this] (int i) { return displayed[AnalyzerTap::output][i] - displayed[AnalyzerTap::reference][i]; });
+        }
+    }
+
+private:
+    //==============================================================================
+    void run() override
+    {
+        // samples from a previous run are stale
+        tap.discard();
+        std::fill (&history[0][0], &history[0][0] + 2 * fftSize, 0.0f);
+        std::fill (&averages[0][0], &averages[0][0] + fftSize, 0.0f);
+
+        while (! threadShouldExit())
+        {
+            if (tap.getNumReady() < hopSize)
+            {
+                wait (10);
+                continue;
+            }
+
+            // the history holds the last fftSize samples, a frame every hopSize samples
+            for (auto& channel : history)
+                std::copy (channel + hopSize, channel + fftSize, channel);
+
+            tap.read (history[AnalyzerTap::output] + fftSize - hopSize, history[AnalyzerTap::reference] + fftSize - hopSize, hopSize);
+
+            for (int channel = 0; channel < 2; ++channel)
+            {
+                std::copy (history[channel], history[channel] + fftSize, fftData);
+                window.multiplyWithWindowingTable (fftData, fftSize);
+                fft.performFrequencyOnlyForwardTransform (fftData);
+
+                // a full-scale sine shows at 0dB: the Hann window halves the amplitude
+                constexpr float scale = 4.0f / fftSize;
+                for (int bin = 0; bin < fftSize / 2; ++bin)
+                {
+                    const float power = juce::square (fftData[bin] * scale);
+                    averages[channel][bin] += averaging * (power - averages[channel][bin]);
+                }
+            }
+
+            decimate();
+
+            {
+                const juce::SpinLock::ScopedLockType lock (pointsLock);
+                std::copy (&points[0][0], &points[0][0] + 2 * numPoints, &sharedPoints[0][0]);
+            }
+
+            hasNewPoints = true;
+        }
+    }
+
+    /** The strongest bin within each display point's frequency range, in dB. */
+    void decimate()
+    {
+        const double binWidth = tap.getSampleRate() / fftSize;
+        const double ratio = std::pow (maxFrequency / minFrequency, 1.0 / numPoints);
+
+        for (int i = 0; i < numPoints; ++i)
+        {
+            const double lower = minFrequency * std::pow (ratio, i);
+            const int firstBin = juce::jlimit (1, fftSize / 2 - 1, static_cast<int> (lower / binWidth));
+            const int lastBin = juce::jlimit (firstBin, fftSize / 2 - 1, static_cast<int> (lower * ratio / binWidth));
+
+            for (int channel = 0; channel < 2; ++channel)
+            {
+                const float maxPower = *std::max_element (averages[channel] + firstBin, averages[channel] + lastBin + 1);
+                points[channel][i] = 10.0f * std::log10 (maxPower + 1.0e-20f);
+            }
+        }
+    }
+
+    void timerCallback() override
+    {
+        if (! hasNewPoints.exchange (false))
+            return;
+
+        {
+            const juce::SpinLock::ScopedLockType lock (pointsLock);
+            std::copy (&sharedPoints[0][0], &sharedPoints[0][0] + 2 * numPoints, &displayed[0][0]);
+        }
+
+        repaint();
+    }
+
+    //==============================================================================
+    static constexpr double minFrequency = 20.0;
+    static constexpr double maxFrequency = 20000.0;
+
+    AnalyzerTap& tap;
+    Mode mode = spectra;
+
+    // analyzer thread
+    juce::dsp::FFT fft;
+    juce::dsp::WindowingFunction<float> window;
+    float fftData[2 * fftSize] = {};
+    float history[2][fftSize] = {};
+    float averages[2][fftSize / 2] = {};
+    float points[2][numPoints] = {};
+
+    juce::SpinLock pointsLock;
+    float sharedPoints[2][numPoints] = {};
+    std::atomic<bool> hasNewPoints { false };
+
+    // message thread
+    float displayed[2][numPoints] = {};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SpectrumAnalyzer)
+};
@@ -0,0 +1,249 @@
+/*
+==============================================================================
+
+ABComparison Plug-in
+Copyright (C) 2018 - Daniel Rudrich
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+==============================================================================
+*/
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+/** The background thread which fills the ring buffers of all StreamingFilePlayers.
+    Hold it via juce::SharedResourcePointer<ReadAheadThread>, so there's only one per process.
+*/
+class ReadAheadThread : public juce::TimeSliceThread
+{
+public:
+    ReadAheadThread() : juce::TimeSliceThread ("ABComparison read-ahead")
+    {
+        startThread();
+    }
+
+    ~ReadAheadThread() override
+    {
+        stopThread (2000);
+    }
+};
+
+
+/** Plays an audio file in sync with the host's transport.
+
+    WAV and AIFF files are memory-mapped, other formats (e.g. FLAC) are streamed. In both cases,
+    the ReadAheadThread reads the file into a ring buffer, so the audio thread never touches the
+    disk: read() only copies from the ring buffer and outputs silence while it's buffering.
+
+    open() and the destructor have to be called while the audio thread doesn't use the player.
+*/
+class StreamingFilePlayer : private juce::TimeSliceClient
+{
+public:
+    static constexpr int ringBufferSize = 1 << 15;
+    static constexpr int readChunkSize = 4096;
+    static constexpr int maxLookAhead = 8192; // seeks start that many samples ahead of the playhead
+
+    StreamingFilePlayer (juce::TimeSliceThread& threadToUse) : readAheadThread (threadToUse) {}
+
+    ~StreamingFilePlayer() override
+    {
+        readAheadThread.removeTimeSliceClient (this);
+    }
+
+    bool open (const juce::File& fileToOpen, juce::AudioFormatManager& formatManager, int maxNumChannels, int maxBlockSize)
+    {
+        readAheadThread.removeTimeSliceClient (this);
+        reader.reset();
+
+        if (auto* format = formatManager.findFormatForFileExtension (fileToOpen.getFileExtension()))
+        {
+            std::unique_ptr<juce::MemoryMappedAudioFormatReader> mappedReader (format->createMemoryMappedReader (fileToOpen));
+            if (mappedReader != nullptr && mappedReader->mapEntireFile())
+                reader = std::move (mappedReader);
+        }
+
+        if (reader == nullptr)
+            reader.reset (formatManager.createReaderFor (fileToOpen));
+
+        if (reader == nullptr)
+            return false;
+
+        file = fileToOpen;
+        const int nCh = juce::jmin (static_cast<int> (reader->numChannels), maxNumChannels);
+        ringBuffer.setSize (nCh, ringBufferSize);
+        prepare (maxBlockSize);
+
+        requestSeek (0, 0);
+        readAheadThread.addTimeSliceClient (this);
+        return true;
+    }
+
+    void prepare (int maxBlockSize)
+    {
+        output.setSize (ringBuffer.getNumChannels(), maxBlockSize);
+    }
+
+    const juce::File& getFile() const noexcept { return file; }
+    double getFileSampleRate() const noexcept { return reader != nullptr ? reader->sampleRate : 0.0; }
+
+    /** Called from the audio thread. While the transport is stopped, the player only prepares
+        the read-ahead for the playhead position, so playback can start without a gap.
+        Returns the channels of the output, or nullptr if there's nothing to play.
+    */
+    const float* const* read (juce::int64 position, int numSamples, bool isPlaying)
+    {
+        if (numSamples > output.getNumSamples())
+        {
+            jassertfalse; // block is larger than announced in prepareToPlay
+            return nullptr;
+        }
+
+        if (seeking.load())
+            return nullptr;
+
+        if (! isPlaying)
+        {
+            if (position != fifoPosition || lookAhead != 0)
+                requestSeek (position, 0);
+
+            return nullptr;
+        }
+
+        int numSilent = 0;
+
+        if (position < fifoPosition)
+        {
+            const auto lead = fifoPosition - position;
+            if (lead > lookAhead)
+            {
+                requestSeek (position + maxLookAhead, maxLookAhead);
+                return nullptr;
+            }
+
+            // we are waiting for the playhead to reach the buffered data
+            if (lead >= numSamples)
+                return nullptr;
+
+            numSilent = static_cast<int> (lead);
+        }
+        else if (position > fifoPosition)
+        {
+            const auto skip = position - fifoPosition;
+            if (skip + numSamples > fifo.getNumReady())
+            {
+                requestSeek (position + maxLookAhead, maxLookAhead);
+                return nullptr;
+            }
+
+            fifo.finishedRead (static_cast<int> (skip));
+            fifoPosition += skip;
+        }
+
+        lookAhead = 0;
+
+        output.clear (0, numSilent);
+        const int numToRead = juce::jmin (numSamples - numSilent, fifo.getNumReady());
+
+        int start1, size1, start2, size2;
+        fifo.prepareToRead (numToRead, start1, size1, start2, size2);
+        for (int ch = 0; ch < output.getNumChannels(); ++ch)
+        {
+            output.copyFrom (ch, numSilent, ringBuffer, ch, start1, size1);
+            output.copyFrom (ch, numSilent + size1, ringBuffer, ch, start2, size2);
+        }
+        fifo.finishedRead (size1 + size2);
+        fifoPosition += size1 + size2;
+
+        // buffer underrun, the playhead will skip over the missing samples in the next block
+        output.clear (numSilent + numToRead, numSamples - numSilent - numToRead);
+
+        return output.getArrayOfReadPointers();
+    }
+
+    int getNumChannels() const noexcept { return output.getNumChannels(); }
+
+private:
+    void requestSeek (juce::int64 position, int lookAheadOfPosition)
+    {
+        lookAhead = lookAheadOfPosition;
+        fifoPosition = position;
+        requestedPosition = position;
+        seeking = true;
+    }
+
+    int useTimeSlice() override
+    {
+        const bool isSeeking = seeking.load();
+        if (isSeeking)
+        {
+            // the audio thread doesn't touch the fifo while seeking
+            fifo.reset();
+            readPosition = requestedPosition.load();
+        }
+
+        const int numToWrite = juce::jmin (readChunkSize, fifo.getFreeSpace());
+        if (numToWrite > 0)
+        {
+            int start1, size1, start2, size2;
+            fifo.prepareToWrite (numToWrite, start1, size1, start2, size2);
+            readFromFile (start1, size1);
+            readFromFile (start2, size2);
+            fifo.finishedWrite (size1 + size2);
+        }
+
+        if (isSeeking)
+            seeking = false;
+
+        return fifo.getFreeSpace() >= readChunkSize ? 0 : 10;
+    }
+
+    void readFromFile (int startInRingBuffer, int numSamples)
+    {
+        if (numSamples <= 0)
+            return;
+
+        // beyond the end of the file (or before its start) there's silence
+        const auto fileRange = juce::Range<juce::int64> (0, reader->lengthInSamples);
+        const auto readRange = fileRange.getIntersectionWith ({ readPosition, readPosition + numSamples });
+
+        ringBuffer.clear (startInRingBuffer, numSamples);
+
+        if (! readRange.isEmpty())
+            reader->read (&ringBuffer, startInRingBuffer + static_cast<int> (readRange.getStart() - readPosition),
+                          static_cast<int> (readRange.getLength()), readRange.getStart(), true, true);
+
+        readPosition += numSamples;
+    }
+
+    juce::TimeSliceThread& readAheadThread;
+
+    juce::File file;
+    std::unique_ptr<juce::AudioFormatReader> reader;
+
+    juce::AudioBuffer<float> ringBuffer;
+    juce::AbstractFifo fifo { ringBufferSize };
+    juce::int64 readPosition = 0; // read-ahead thread
+
+    juce::AudioBuffer<float> output;
+    juce::int64 fifoPosition = 0; // audio thread: file position of the next sample in the fifo
+    juce::int64 lookAhead = 0; // audio thread: how far the last seek started ahead of the playhead
+
+    std::atomic<juce::int64> requestedPosition { 0 };
+    std::atomic<bool> seeking { false };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (StreamingFilePlayer)
+};